@@ -0,0 +1,13 @@
+# Timed by bin/compare-builds.js. Mixes calls, which Asyncify instruments,
+# with sleeps and display updates, which yield to JavaScript.
+from microbit import display, sleep
+
+
+def fib(n):
+    return n if n < 2 else fib(n - 1) + fib(n - 2)
+
+
+for i in range(50):
+    fib(16)
+    display.set_pixel(i % 5, i // 5 % 5, 9)
+    sleep(1)
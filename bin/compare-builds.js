@@ -0,0 +1,65 @@
+#!/usr/bin/env node
+// Compares the size and speed of the Asyncify and JSPI builds.
+// Run "make jspi" first. Speed is the median time the headless runner takes
+// to run benchmark.py.
+const childProcess = require("child_process");
+const fs = require("fs");
+const path = require("path");
+const zlib = require("zlib");
+
+const buildDir = path.join(__dirname, "..", "build", "build");
+const headless = path.join(__dirname, "..", "src", "build", "headless.js");
+const benchmark = path.join(__dirname, "benchmark.py");
+const variants = ["firmware", "firmware-jspi"];
+const runs = 5;
+
+const kb = (bytes) => `${(bytes / 1024).toFixed(1)} KiB`;
+
+for (const variant of variants) {
+  for (const extension of ["wasm", "js"]) {
+    const file = path.join(buildDir, `${variant}.${extension}`);
+    if (!fs.existsSync(file)) {
+      console.error(`Missing ${file}, run "make jspi"`);
+      process.exit(1);
+    }
+    const data = fs.readFileSync(file);
+    const gzipped = zlib.gzipSync(data, { level: 9 });
+    console.log(
+      `${path.basename(file).padEnd(20)} ${kb(data.length).padStart(12)} ${kb(
+        gzipped.length
+      ).padStart(12)} gzip`
+    );
+  }
+}
+
+// Older Node versions have JSPI behind a flag.
+const nodeArgs =
+  typeof WebAssembly.Suspending === "undefined"
+    ? ["--experimental-wasm-jspi"]
+    : [];
+
+const time = (variant) => {
+  const result = childProcess.spawnSync(
+    process.execPath,
+    [...nodeArgs, headless, "--firmware", variant, benchmark],
+    { encoding: "utf-8" }
+  );
+  if (result.status !== 0) {
+    throw new Error(`${variant} failed: ${result.stderr}`);
+  }
+  const { stopReason, durationMs, error } = JSON.parse(result.stdout);
+  if (stopReason !== "finished") {
+    throw new Error(`${variant} stopped with ${stopReason}: ${error ?? ""}`);
+  }
+  return durationMs;
+};
+
+for (const variant of variants) {
+  const times = Array.from({ length: runs }, () => time(variant)).sort(
+    (a, b) => a - b
+  );
+  const ms = `${times[Math.floor(runs / 2)].toFixed(0)} ms`;
+  console.log(
+    `${variant.padEnd(20)} ${ms.padStart(12)} median of ${runs} runs`
+  );
+}
@@ -13,4 +13,5 @@ git clone https://github.com/emscripten-core/emsdk.git -b $VERSION ~/.emsdk
 ~/.emsdk/emsdk activate $VERSION
 source ~/.emsdk/emsdk_env.sh
 
-npm run test && npm run build
+# Build first so the tests that need the firmware run.
+npm run build && npm run test
@@ -0,0 +1,65 @@
+import { ResamplingReader, SampleRing } from "./board/audio/sample-ring";
+import {
+  AudioSinkProcessorOptions,
+  audioSinkProcessorName,
+  FromAudioSinkMessage,
+  ToAudioSinkMessage,
+} from "./board/audio/worklet-protocol";
+
+// Plays samples the simulator writes to a shared ring, resampled to the
+// context's rate, and asks for more when it runs low. Runs on the audio
+// rendering thread so playback doesn't depend on the main thread keeping up.
+
+// AudioWorkletGlobalScope isn't in the DOM lib.
+declare const sampleRate: number;
+declare function registerProcessor(name: string, processor: unknown): void;
+declare class AudioWorkletProcessor {
+  readonly port: MessagePort;
+}
+
+class AudioSinkProcessor extends AudioWorkletProcessor {
+  private reader: ResamplingReader;
+  private lowWatermark = 0;
+  private low = false;
+  private disposed = false;
+
+  constructor(options: { processorOptions: AudioSinkProcessorOptions }) {
+    super();
+    this.reader = new ResamplingReader(
+      new SampleRing(options.processorOptions.ring),
+      sampleRate
+    );
+    this.port.onmessage = (e: MessageEvent<ToAudioSinkMessage>) => {
+      const message = e.data;
+      switch (message.kind) {
+        case "init": {
+          this.reader.setInputRate(message.sampleRate);
+          this.lowWatermark = message.lowWatermark;
+          break;
+        }
+        case "dispose": {
+          this.disposed = true;
+          break;
+        }
+      }
+    };
+  }
+
+  process(_inputs: Float32Array[][], outputs: Float32Array[][]): boolean {
+    if (this.disposed) {
+      return false;
+    }
+    this.reader.read(outputs[0][0]);
+    // Ask once each time we drop below the watermark. The sink tops up
+    // from there.
+    const low = this.reader.buffered() < this.lowWatermark;
+    if (low && !this.low) {
+      const message: FromAudioSinkMessage = { kind: "low" };
+      this.port.postMessage(message);
+    }
+    this.low = low;
+    return true;
+  }
+}
+
+registerProcessor(audioSinkProcessorName, AudioSinkProcessor);
@@ -0,0 +1,255 @@
+import { readFileSync } from "fs";
+import { cpus } from "os";
+import { isMainThread, parentPort, Worker, workerData } from "worker_threads";
+import {
+  compileFirmware,
+  HeadlessResult,
+  HeadlessRunner,
+  HeadlessScript,
+} from "./headless-runner";
+
+// Runs many programs against sensor scripts across worker threads, e.g. to
+// grade submissions.
+//
+// Usage: node build/batch.js [--jobs n] [--timeout ms] [--js-heap mb]
+//          [--virtual-time] [--script script.json]... program.py...
+//
+// Each program runs once per script, or once with no inputs. Scripts are as
+// for headless.js with main.py taken from the program. Prints a result as
+// JSON for each run and the throughput to stderr.
+//
+// --js-heap limits each thread's JavaScript heap. It doesn't cover the Wasm
+// memory, which holds the MicroPython heap and is a fixed size.
+
+interface BatchJob {
+  id: number;
+  program: string;
+  script: string | undefined;
+  run: HeadlessScript;
+}
+
+interface BatchResult {
+  id: number;
+  result: HeadlessResult;
+}
+
+interface BatchWorkerData {
+  firmware: string;
+  compiledWasm: WebAssembly.Module;
+}
+
+interface BatchOptions {
+  firmware: string;
+  jobs: number;
+  timeoutMs: number;
+  jsHeapMb: number | undefined;
+  virtualTime: boolean | undefined;
+}
+
+// How long past its timeout a run can take before we assume the worker is
+// stuck and replace it.
+const watchdogGraceMs = 5_000;
+
+const failed = (error: string): HeadlessResult => ({
+  serial: "",
+  display: [],
+  radio: [],
+  log: [],
+  stopReason: "error",
+  error,
+  durationMs: 0,
+});
+
+const runWorkerThread = () => {
+  const { firmware, compiledWasm } = workerData as BatchWorkerData;
+  const runner = new HeadlessRunner(firmware, compiledWasm);
+  // Jobs arrive one at a time so runs don't overlap.
+  parentPort!.on("message", async (job: BatchJob) => {
+    let result: HeadlessResult;
+    try {
+      result = await runner.run(job.run);
+    } catch (e) {
+      result = failed(String(e));
+    }
+    const message: BatchResult = { id: job.id, result };
+    parentPort!.postMessage(message);
+  });
+};
+
+/**
+ * A worker thread with its own instance of the runner.
+ */
+class BatchWorker {
+  private worker: Worker;
+
+  constructor(
+    private data: BatchWorkerData,
+    private jsHeapMb: number | undefined
+  ) {
+    this.worker = this.spawn();
+  }
+
+  /**
+   * Run a job, replacing the thread if it fails or doesn't respond in time.
+   */
+  run(job: BatchJob, watchdogMs: number) {
+    return new Promise<HeadlessResult>((resolve) => {
+      const worker = this.worker;
+      const finish = (result: HeadlessResult, replace: boolean) => {
+        clearTimeout(watchdog);
+        worker.off("message", onMessage);
+        worker.off("error", onError);
+        if (replace) {
+          worker.terminate();
+          this.worker = this.spawn();
+        }
+        resolve(result);
+      };
+      const onMessage = (message: BatchResult) => {
+        if (message.id === job.id) {
+          finish(message.result, false);
+        }
+      };
+      // E.g. ERR_WORKER_OUT_OF_MEMORY if over the JavaScript heap limit.
+      const onError = (e: Error) => finish(failed(String(e)), true);
+      const watchdog = setTimeout(
+        () => finish(failed("Worker did not respond"), true),
+        watchdogMs
+      );
+      worker.on("message", onMessage);
+      worker.on("error", onError);
+      worker.postMessage(job);
+    });
+  }
+
+  terminate() {
+    return this.worker.terminate();
+  }
+
+  private spawn() {
+    return new Worker(__filename, {
+      workerData: this.data,
+      resourceLimits: this.jsHeapMb
+        ? { maxOldGenerationSizeMb: this.jsHeapMb }
+        : undefined,
+    });
+  }
+}
+
+const runBatch = async (
+  jobs: BatchJob[],
+  options: BatchOptions,
+  onResult: (job: BatchJob, result: HeadlessResult) => void
+) => {
+  const data: BatchWorkerData = {
+    firmware: options.firmware,
+    // Compile once and share with all the threads.
+    compiledWasm: compileFirmware(options.firmware),
+  };
+  const queue = [...jobs];
+  const slots = Array.from(
+    Array(Math.min(options.jobs, jobs.length)),
+    async () => {
+      const worker = new BatchWorker(data, options.jsHeapMb);
+      for (let job = queue.shift(); job; job = queue.shift()) {
+        const watchdogMs =
+          (job.run.timeoutMs ?? options.timeoutMs) + watchdogGraceMs;
+        onResult(job, await worker.run(job, watchdogMs));
+      }
+      await worker.terminate();
+    }
+  );
+  await Promise.all(slots);
+};
+
+const usage = (): never => {
+  console.error(
+    "Usage: batch.js [--jobs n] [--timeout ms] [--js-heap mb] [--virtual-time] [--firmware name] [--script script.json]... program.py..."
+  );
+  process.exit(2);
+};
+
+const main = async (args: string[]) => {
+  const options: BatchOptions = {
+    firmware: "firmware",
+    jobs: cpus().length,
+    timeoutMs: 10_000,
+    jsHeapMb: undefined,
+    virtualTime: undefined,
+  };
+  const scripts: string[] = [];
+  const programs: string[] = [];
+  for (let i = 0; i < args.length; i++) {
+    const value = () => args[++i] ?? usage();
+    switch (args[i]) {
+      case "--jobs":
+        options.jobs = parseInt(value(), 10);
+        break;
+      case "--timeout":
+        options.timeoutMs = parseInt(value(), 10);
+        break;
+      case "--js-heap":
+        options.jsHeapMb = parseInt(value(), 10);
+        break;
+      case "--virtual-time":
+        options.virtualTime = true;
+        break;
+      case "--firmware":
+        options.firmware = value();
+        break;
+      case "--script":
+        scripts.push(value());
+        break;
+      default:
+        programs.push(args[i]);
+    }
+  }
+  if (programs.length === 0 || !(options.jobs > 0)) {
+    usage();
+  }
+
+  const loadedScripts = scripts.map(
+    (file): HeadlessScript => JSON.parse(readFileSync(file, "utf-8"))
+  );
+  const jobs: BatchJob[] = [];
+  for (const program of programs) {
+    const source = readFileSync(program, "utf-8");
+    const runs = scripts.length ? scripts : [undefined];
+    runs.forEach((script, i) => {
+      const base: HeadlessScript = script ? loadedScripts[i] : { files: {} };
+      jobs.push({
+        id: jobs.length,
+        program,
+        script,
+        run: {
+          timeoutMs: options.timeoutMs,
+          virtualTime: options.virtualTime,
+          ...base,
+          files: { ...base.files, "main.py": source },
+        },
+      });
+    });
+  }
+
+  const start = performance.now();
+  await runBatch(jobs, options, (job, result) => {
+    const { program, script } = job;
+    process.stdout.write(JSON.stringify({ program, script, ...result }) + "\n");
+  });
+  const seconds = (performance.now() - start) / 1000;
+  const threads = Math.min(options.jobs, jobs.length);
+  const rate = (count: number) => (count / seconds).toFixed(1);
+  console.error(
+    `${jobs.length} runs in ${seconds.toFixed(1)}s on ${threads} threads: ` +
+      `${rate(programs.length)} programs/s, ${rate(jobs.length)} runs/s`
+  );
+};
+
+if (isMainThread) {
+  main(process.argv.slice(2)).catch((e) => {
+    console.error(e);
+    process.exit(1);
+  });
+} else {
+  runWorkerThread();
+}
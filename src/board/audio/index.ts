@@ -1,6 +1,10 @@
-import { replaceBuiltinSound } from "./built-in-sounds";
-import { SoundEmojiSynthesizer } from "./sound-emoji-synthesizer";
-import { parseSoundEffects } from "./sound-expressions";
+import { SampleRing } from "./sample-ring";
+import {
+  AudioSinkProcessorOptions,
+  audioSinkProcessorName,
+  FromAudioSinkMessage,
+  ToAudioSinkMessage,
+} from "./worklet-protocol";
 
 declare global {
   interface Window {
@@ -11,6 +15,19 @@ declare global {
 interface AudioOptions {
   defaultAudioCallback: () => void;
   speechAudioCallback: () => void;
+  expressionAudioCallback: () => void;
+}
+
+/**
+ * Plays a stream of samples written in chunks, calling back for more.
+ */
+interface AudioSink {
+  init(sampleRate: number): void;
+  /**
+   * Queue samples in -1..+1. They're copied so the caller can reuse them.
+   */
+  writeSamples(samples: Float32Array): void;
+  dispose(): void;
 }
 
 export class Audio {
@@ -21,21 +38,24 @@ export class Audio {
   private oscillator: OscillatorNode | undefined;
   private volumeNode: GainNode | undefined;
   private muteNode: GainNode | undefined;
+  private workletLoaded: Promise<boolean> | undefined;
+  private useWorklet = false;
 
-  default: BufferedAudio | undefined;
-  speech: BufferedAudio | undefined;
-  soundExpression: BufferedAudio | undefined;
-  currentSoundExpressionCallback: undefined | (() => void);
+  default: AudioSink | undefined;
+  speech: AudioSink | undefined;
+  soundExpression: AudioSink | undefined;
 
   constructor() {}
 
-  initializeCallbacks({
-    defaultAudioCallback,
-    speechAudioCallback,
-  }: AudioOptions) {
+  initializeCallbacks(options: AudioOptions) {
     if (!this.context) {
       throw new Error("Context must be pre-created from a user event");
     }
+    const {
+      defaultAudioCallback,
+      speechAudioCallback,
+      expressionAudioCallback,
+    } = options;
     this.muteNode = this.context.createGain();
     this.muteNode.gain.setValueAtTime(
       this.muted ? 0 : 1,
@@ -45,24 +65,17 @@ export class Audio {
     this.volumeNode = this.context.createGain();
     this.volumeNode.connect(this.muteNode);
 
-    this.default = new BufferedAudio(
+    const Sink = this.useWorklet ? WorkletAudio : BufferedAudio;
+    this.default = new Sink(
       this.context,
       this.volumeNode,
       defaultAudioCallback
     );
-    this.speech = new BufferedAudio(
-      this.context,
-      this.volumeNode,
-      speechAudioCallback
-    );
-    this.soundExpression = new BufferedAudio(
+    this.speech = new Sink(this.context, this.volumeNode, speechAudioCallback);
+    this.soundExpression = new Sink(
       this.context,
       this.volumeNode,
-      () => {
-        if (this.currentSoundExpressionCallback) {
-          this.currentSoundExpressionCallback();
-        }
-      }
+      expressionAudioCallback
     );
   }
 
@@ -73,46 +86,19 @@ export class Audio {
         // The highest rate is the sound expression synth.
         sampleRate: 44100,
       });
-    if (this.context.state === "suspended") {
-      return this.context.resume();
-    }
-  }
-
-  playSoundExpression(expr: string) {
-    const soundEffects = parseSoundEffects(replaceBuiltinSound(expr));
-    const onDone = () => {
-      this.stopSoundExpression();
-    };
-    const synth = new SoundEmojiSynthesizer(0, onDone);
-    synth.play(soundEffects);
-
-    const callback = () => {
-      const source = synth.pull();
-      if (this.context) {
-        // Use createBuffer instead of new AudioBuffer to support Safari 14.0.
-        const target = this.context.createBuffer(
-          1,
-          source.length,
-          synth.sampleRate
+    if (!this.workletLoaded && WorkletAudio.isSupported(this.context)) {
+      this.workletLoaded = this.context.audioWorklet
+        .addModule("./build/audio-worklet.js")
+        .then(
+          () => true,
+          // Fall back to buffer source nodes.
+          () => false
         );
-        const channel = target.getChannelData(0);
-        for (let i = 0; i < source.length; i++) {
-          // Buffer is (0, 1023) we need to map it to (-1, 1)
-          channel[i] = (source[i] - 512) / 512;
-        }
-        this.soundExpression!.writeData(target);
-      }
-    };
-    this.currentSoundExpressionCallback = callback;
-    callback();
-  }
-
-  stopSoundExpression(): void {
-    this.currentSoundExpressionCallback = undefined;
-  }
-
-  isSoundExpressionActive(): boolean {
-    return !!this.currentSoundExpressionCallback;
+    }
+    const resumed =
+      this.context.state === "suspended" ? this.context.resume() : undefined;
+    this.useWorklet = (await this.workletLoaded) ?? false;
+    return resumed;
   }
 
   mute() {
@@ -170,7 +156,11 @@ export class Audio {
   }
 }
 
-class BufferedAudio {
+/**
+ * Schedules a buffer source node per chunk, asking for the next chunk as
+ * each one starts playing.
+ */
+class BufferedAudio implements AudioSink {
   nextStartTime: number = -1;
   private sampleRate: number = -1;
 
@@ -185,12 +175,19 @@ class BufferedAudio {
     this.nextStartTime = -1;
   }
 
-  createBuffer(length: number) {
-    // Use createBuffer instead of new AudioBuffer to support Safari 14.0.
-    return this.context.createBuffer(1, length, this.sampleRate);
-  }
-
-  writeData(buffer: AudioBuffer) {
+  writeSamples(samples: Float32Array) {
+    let buffer: AudioBuffer;
+    try {
+      // Use createBuffer instead of new AudioBuffer to support Safari 14.0.
+      buffer = this.context.createBuffer(1, samples.length, this.sampleRate);
+    } catch (e: any) {
+      // Swallow error on older Safari to keep the sim in a good state.
+      if (e.name === "NotSupportedError") {
+        return;
+      }
+      throw e;
+    }
+    buffer.getChannelData(0).set(samples);
     // Use createBufferSource instead of new AudioBufferSourceNode to support Safari 14.0.
     const source = this.context.createBufferSource();
     source.buffer = buffer;
@@ -213,3 +210,76 @@ class BufferedAudio {
     this.callback = () => {};
   }
 }
+
+// Samples at the source rate. About 0.75s at the highest rate we use.
+const workletRingCapacity = 32768;
+// Buffered audio to aim for. Covers main thread stalls without much latency.
+const lowWatermarkMs = 60;
+
+/**
+ * Writes samples to a ring read by a processor in the audio worklet, which
+ * asks for more when it runs low. No nodes or buffers are created per chunk.
+ *
+ * Requires cross-origin isolation for SharedArrayBuffer.
+ */
+class WorkletAudio implements AudioSink {
+  private ring = SampleRing.create(workletRingCapacity);
+  private node: AudioWorkletNode;
+  private lowWatermark = 0;
+
+  static isSupported(context: AudioContext): boolean {
+    return (
+      typeof SharedArrayBuffer !== "undefined" &&
+      crossOriginIsolated &&
+      typeof AudioWorkletNode !== "undefined" &&
+      !!context.audioWorklet
+    );
+  }
+
+  constructor(
+    context: AudioContext,
+    destination: AudioNode,
+    private callback: () => void
+  ) {
+    const processorOptions: AudioSinkProcessorOptions = {
+      ring: this.ring.buffer,
+    };
+    this.node = new AudioWorkletNode(context, audioSinkProcessorName, {
+      numberOfInputs: 0,
+      outputChannelCount: [1],
+      processorOptions,
+    });
+    this.node.port.onmessage = (e: MessageEvent<FromAudioSinkMessage>) => {
+      if (e.data.kind === "low") {
+        this.callback();
+      }
+    };
+    this.node.connect(destination);
+  }
+
+  init(sampleRate: number) {
+    this.lowWatermark = Math.ceil((sampleRate * lowWatermarkMs) / 1000);
+    this.post({ kind: "init", sampleRate, lowWatermark: this.lowWatermark });
+  }
+
+  writeSamples(samples: Float32Array) {
+    // Anything that doesn't fit is dropped. We only ask for more below the
+    // watermark so there's normally plenty of room.
+    this.ring.write(samples);
+    if (this.ring.available() < this.lowWatermark) {
+      // Top up, e.g. when we're just getting started.
+      this.callback();
+    }
+  }
+
+  dispose() {
+    // Prevent calls into WASM for more data.
+    this.callback = () => {};
+    this.post({ kind: "dispose" });
+    this.node.disconnect();
+  }
+
+  private post(message: ToAudioSinkMessage) {
+    this.node.port.postMessage(message);
+  }
+}
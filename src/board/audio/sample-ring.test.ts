@@ -0,0 +1,50 @@
+import { describe, expect, it } from "vitest";
+import { ResamplingReader, SampleRing } from "./sample-ring";
+
+describe("SampleRing", () => {
+  it("writes whole samples that fit", () => {
+    const ring = SampleRing.create(4);
+    expect(ring.write(new Float32Array([0.1, 0.2, 0.3, 0.4, 0.5]))).toEqual(4);
+    expect(ring.available()).toEqual(4);
+    const target = new Float32Array(3);
+    expect(ring.read(target)).toEqual(3);
+    expect(target).toEqual(new Float32Array([0.1, 0.2, 0.3]));
+    expect(ring.write(new Float32Array([0.6, 0.7]))).toEqual(2);
+    expect(ring.read(target)).toEqual(3);
+    expect(target).toEqual(new Float32Array([0.4, 0.6, 0.7]));
+  });
+});
+
+describe("ResamplingReader", () => {
+  it("passes through samples at the output rate", () => {
+    const ring = SampleRing.create(16);
+    const reader = new ResamplingReader(ring, 100);
+    reader.setInputRate(100);
+    ring.write(new Float32Array([0.25, 0.5, -0.5, 1]));
+    const output = new Float32Array(4);
+    expect(reader.read(output)).toEqual(true);
+    // One sample behind as it interpolates towards the next.
+    expect(output).toEqual(new Float32Array([0, 0.25, 0.5, -0.5]));
+  });
+
+  it("interpolates up to the output rate", () => {
+    const ring = SampleRing.create(16);
+    const reader = new ResamplingReader(ring, 200);
+    reader.setInputRate(100);
+    ring.write(new Float32Array([0.5, 1, 0]));
+    const output = new Float32Array(5);
+    expect(reader.read(output)).toEqual(true);
+    expect(output).toEqual(new Float32Array([0, 0.25, 0.5, 0.75, 1]));
+    expect(reader.buffered()).toEqual(0);
+  });
+
+  it("outputs silence when it runs out", () => {
+    const ring = SampleRing.create(16);
+    const reader = new ResamplingReader(ring, 100);
+    reader.setInputRate(100);
+    ring.write(new Float32Array([0.5, 0.5]));
+    const output = new Float32Array(4).fill(1);
+    expect(reader.read(output)).toEqual(false);
+    expect(output).toEqual(new Float32Array([0, 0.5, 0, 0]));
+  });
+});
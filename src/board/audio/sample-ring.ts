@@ -0,0 +1,110 @@
+import { RingBuffer } from "../ring";
+
+const bytesPerSample = 4;
+
+/**
+ * Float samples in a RingBuffer, written on the HAL's side and read by the
+ * audio worklet.
+ */
+export class SampleRing {
+  private ring: RingBuffer;
+
+  constructor(public readonly buffer: SharedArrayBuffer) {
+    this.ring = new RingBuffer(buffer);
+  }
+
+  static create(capacity: number): SampleRing {
+    return new SampleRing(RingBuffer.create(capacity * bytesPerSample).buffer);
+  }
+
+  /**
+   * The number of samples that can be read.
+   */
+  available(): number {
+    return Math.floor(this.ring.available() / bytesPerSample);
+  }
+
+  /**
+   * Producer only. Writes as many whole samples as fit.
+   *
+   * @returns the number of samples written.
+   */
+  write(samples: Float32Array): number {
+    const space = Math.floor(this.ring.space() / bytesPerSample);
+    const length = Math.min(samples.length, space);
+    const bytes = length * bytesPerSample;
+    this.ring.write(new Uint8Array(samples.buffer, samples.byteOffset, bytes));
+    return length;
+  }
+
+  /**
+   * Consumer only. Reads up to target.length samples.
+   *
+   * @returns the number of samples read.
+   */
+  read(target: Float32Array): number {
+    const bytes = new Uint8Array(
+      target.buffer,
+      target.byteOffset,
+      target.length * bytesPerSample
+    );
+    return this.ring.read(bytes) / bytesPerSample;
+  }
+}
+
+/**
+ * Reads samples from a ring at their own rate and linearly interpolates them
+ * to the output rate.
+ */
+export class ResamplingReader {
+  private step = 1;
+  // Position between previous and next, reading another sample at 1.
+  private phase = 1;
+  private previous = 0;
+  private next = 0;
+  // Samples taken from the ring but not used yet.
+  private input = new Float32Array(512);
+  private inputIndex = 0;
+  private inputLength = 0;
+
+  constructor(private ring: SampleRing, private outputRate: number) {}
+
+  setInputRate(inputRate: number) {
+    this.step = inputRate / this.outputRate;
+  }
+
+  /**
+   * The number of input samples waiting to be played.
+   */
+  buffered(): number {
+    return this.ring.available() + this.inputLength - this.inputIndex;
+  }
+
+  /**
+   * Fill output, with silence after the input runs out.
+   *
+   * @returns false if the input ran out.
+   */
+  read(output: Float32Array): boolean {
+    for (let i = 0; i < output.length; i++) {
+      while (this.phase >= 1) {
+        if (this.inputIndex === this.inputLength && !this.fillInput()) {
+          output.fill(0, i);
+          return false;
+        }
+        this.previous = this.next;
+        this.next = this.input[this.inputIndex++];
+        this.phase -= 1;
+      }
+      output[i] = this.previous + (this.next - this.previous) * this.phase;
+      this.phase += this.step;
+    }
+    return true;
+  }
+
+  private fillInput(): boolean {
+    this.inputIndex = 0;
+    this.inputLength = this.ring.read(this.input);
+    return this.inputLength > 0;
+  }
+}
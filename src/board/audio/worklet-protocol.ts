@@ -0,0 +1,26 @@
+/**
+ * Messages between an AudioSink and its processor in the audio worklet, see
+ * audio-worklet.ts.
+ */
+
+export const audioSinkProcessorName = "microbit-audio-sink";
+
+export interface AudioSinkProcessorOptions {
+  /**
+   * A SampleRing's buffer.
+   */
+  ring: SharedArrayBuffer;
+}
+
+export type ToAudioSinkMessage =
+  | {
+      kind: "init";
+      sampleRate: number;
+      /**
+       * Ask for more when fewer samples than this are buffered.
+       */
+      lowWatermark: number;
+    }
+  | { kind: "dispose" };
+
+export type FromAudioSinkMessage = { kind: "low" };
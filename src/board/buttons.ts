@@ -1,9 +1,35 @@
 import { RangeSensor, State } from "./state";
 
-export class Button {
-  public state: RangeSensor;
+abstract class BaseButton {
+  state: RangeSensor;
 
-  private _presses: number = 0;
+  private presses: number = 0;
+
+  constructor(id: "buttonA" | "buttonB") {
+    this.state = new RangeSensor(id, 0, 1, 0, undefined);
+  }
+
+  setValue(value: any) {
+    this.state.setValue(value);
+    if (value) {
+      this.presses++;
+    }
+  }
+
+  getAndClearPresses() {
+    const result = this.presses;
+    this.presses = 0;
+    return result;
+  }
+
+  boardStopped() {
+    this.presses = 0;
+  }
+}
+
+export class StubButton extends BaseButton {}
+
+export class Button extends BaseButton {
   private _mouseDown: boolean = false;
 
   private keyListener: (e: KeyboardEvent) => void;
@@ -18,8 +44,7 @@ export class Button {
     private label: () => string,
     private onChange: (change: Partial<State>) => void
   ) {
-    this._presses = 0;
-    this.state = new RangeSensor(id, 0, 1, 0, undefined);
+    super(id);
 
     this.element.setAttribute("role", "button");
     this.element.setAttribute("tabindex", "0");
@@ -77,10 +102,7 @@ export class Button {
   }
 
   private setValueInternal(value: any, internalChange: boolean) {
-    this.state.setValue(value);
-    if (value) {
-      this._presses++;
-    }
+    super.setValue(value);
     if (internalChange) {
       this.onChange({
         [this.id]: this.state,
@@ -118,14 +140,4 @@ export class Button {
       c.style.fill = fill;
     });
   }
-
-  getAndClearPresses() {
-    const result = this._presses;
-    this._presses = 0;
-    return result;
-  }
-
-  boardStopped() {
-    this._presses = 0;
-  }
 }
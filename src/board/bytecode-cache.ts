@@ -0,0 +1,114 @@
+import { promisify } from "./util";
+
+const dbName = "simulator-bytecode";
+const storeName = "bytecode";
+
+interface PersistedEntry {
+  build: string;
+  data: Uint8Array;
+}
+
+/**
+ * Compiled MicroPython code (.mpy format) keyed on the name and content of
+ * the source file, so restarting an unchanged program skips the compiler.
+ *
+ * The HAL needs synchronous access so entries are held in memory. If
+ * persistent they are also stored in IndexedDB, keyed on the firmware build
+ * as compiled code is only valid for the firmware that compiled it, and
+ * load() must complete before the cache is used.
+ */
+export class BytecodeCache {
+  // In least recently used order.
+  private entries = new Map<string, Uint8Array>();
+  private loaded: Promise<void> | undefined;
+  private db: IDBDatabase | undefined;
+  private build: string | undefined;
+
+  constructor(readonly persistent: boolean, private maxEntries: number = 32) {}
+
+  get(key: string): Uint8Array | undefined {
+    const data = this.entries.get(key);
+    if (data) {
+      this.entries.delete(key);
+      this.entries.set(key, data);
+    }
+    return data;
+  }
+
+  put(key: string, data: Uint8Array): void {
+    this.entries.delete(key);
+    this.entries.set(key, data);
+    this.persist((store) => {
+      const entry: PersistedEntry = { build: this.build!, data };
+      store.put(entry, key);
+    });
+    this.evict();
+  }
+
+  /**
+   * Load persisted entries. Safe to call repeatedly.
+   *
+   * @param build Identifies the firmware, only called if persistent.
+   */
+  load(build: () => Promise<string>): Promise<void> {
+    if (!this.loaded) {
+      this.loaded = this.loadInternal(build).catch((e) => {
+        // Caching is an optimisation so carry on without persistence.
+        console.error("Failed to load bytecode cache");
+        console.error(e);
+        this.db = undefined;
+      });
+    }
+    return this.loaded;
+  }
+
+  private async loadInternal(build: () => Promise<string>): Promise<void> {
+    if (!this.persistent || typeof indexedDB === "undefined") {
+      return;
+    }
+    this.build = await build();
+    const request = indexedDB.open(dbName, 1);
+    request.onupgradeneeded = () => {
+      request.result.createObjectStore(storeName);
+    };
+    this.db = await promisify(request);
+    const store = this.db
+      .transaction(storeName, "readonly")
+      .objectStore(storeName);
+    const [keys, values] = await Promise.all([
+      promisify(store.getAllKeys()),
+      promisify(store.getAll() as IDBRequest<PersistedEntry[]>),
+    ]);
+    const stale: IDBValidKey[] = [];
+    keys.forEach((key, i) => {
+      const value = values[i];
+      if (typeof key === "string" && value.build === this.build) {
+        this.entries.set(key, value.data);
+      } else {
+        stale.push(key);
+      }
+    });
+    this.persist((store) => stale.forEach((key) => store.delete(key)));
+    this.evict();
+  }
+
+  private evict() {
+    while (this.entries.size > this.maxEntries) {
+      const oldest = this.entries.keys().next().value as string;
+      this.entries.delete(oldest);
+      this.persist((store) => store.delete(oldest));
+    }
+  }
+
+  private persist(action: (store: IDBObjectStore) => void) {
+    if (this.db) {
+      try {
+        action(
+          this.db.transaction(storeName, "readwrite").objectStore(storeName)
+        );
+      } catch (e) {
+        // Ignore, e.g. storage quota issues.
+      }
+    }
+  }
+}
@@ -0,0 +1,47 @@
+import { describe, expect, it } from "vitest";
+import { VirtualClock } from "./clock";
+
+describe("VirtualClock", () => {
+  it("only moves when advanced", () => {
+    const clock = new VirtualClock();
+    expect(clock.now()).toEqual(0);
+    clock.advance(5);
+    clock.advance(0.5);
+    expect(clock.now()).toEqual(5.5);
+  });
+
+  it("calls timers in order at their due time", () => {
+    const clock = new VirtualClock();
+    const calls: string[] = [];
+    const record = (name: string) => () =>
+      calls.push(`${name}@${clock.now()}`);
+    clock.schedule(record("b"), 20);
+    clock.schedule(record("a"), 10);
+    clock.schedule(record("c"), 20);
+    clock.advance(15);
+    expect(calls).toEqual(["a@10"]);
+    clock.advance(100);
+    expect(calls).toEqual(["a@10", "b@20", "c@20"]);
+    expect(clock.now()).toEqual(115);
+  });
+
+  it("calls timers scheduled by timers", () => {
+    const clock = new VirtualClock();
+    const calls: number[] = [];
+    clock.schedule(() => {
+      calls.push(clock.now());
+      clock.schedule(() => calls.push(clock.now()), 5);
+    }, 5);
+    clock.advance(10);
+    expect(calls).toEqual([5, 10]);
+  });
+
+  it("cancels timers", () => {
+    const clock = new VirtualClock();
+    let called = false;
+    const cancel = clock.schedule(() => (called = true), 1);
+    cancel();
+    clock.advance(10);
+    expect(called).toEqual(false);
+  });
+});
@@ -0,0 +1,71 @@
+/**
+ * A source of time and timers for the headless board.
+ */
+export interface Clock {
+  /**
+   * Milliseconds from an arbitrary origin.
+   */
+  now(): number;
+
+  /**
+   * Call callback after delayMs.
+   *
+   * @returns A function that cancels the call.
+   */
+  schedule(callback: () => void, delayMs: number): () => void;
+}
+
+export class RealClock implements Clock {
+  now(): number {
+    return performance.now();
+  }
+
+  schedule(callback: () => void, delayMs: number): () => void {
+    const timeout = setTimeout(callback, delayMs);
+    return () => clearTimeout(timeout);
+  }
+}
+
+interface VirtualTimer {
+  atMs: number;
+  callback: () => void;
+}
+
+/**
+ * Time that only moves when advanced, so waits take no real time and runs
+ * are repeatable.
+ */
+export class VirtualClock implements Clock {
+  private timeMs = 0;
+  // Ordered by time then by when they were scheduled.
+  private timers: VirtualTimer[] = [];
+
+  now(): number {
+    return this.timeMs;
+  }
+
+  schedule(callback: () => void, delayMs: number): () => void {
+    const timer = { atMs: this.timeMs + Math.max(0, delayMs), callback };
+    const index = this.timers.findIndex((t) => t.atMs > timer.atMs);
+    this.timers.splice(index === -1 ? this.timers.length : index, 0, timer);
+    return () => {
+      const index = this.timers.indexOf(timer);
+      if (index !== -1) {
+        this.timers.splice(index, 1);
+      }
+    };
+  }
+
+  /**
+   * Move time forward, calling timers that fall due on the way.
+   */
+  advance(ms: number): void {
+    const target = this.timeMs + ms;
+    while (this.timers.length > 0 && this.timers[0].atMs <= target) {
+      const timer = this.timers.shift()!;
+      this.timeMs = timer.atMs;
+      timer.callback();
+    }
+    this.timeMs = target;
+  }
+}
@@ -20,12 +20,5 @@ export class Compass {
     this.state[id].setValue(value);
   }
 
-  getFieldStrength() {
-    const x = this.state.compassX.value;
-    const y = this.state.compassY.value;
-    const z = this.state.compassZ.value;
-    return Math.sqrt(x * x + y * y + z * z);
-  }
-
   boardStopped() {}
 }
@@ -67,3 +67,23 @@ export const MICROBIT_HAL_LOG_TIMESTAMP_SECONDS = 10;
 export const MICROBIT_HAL_LOG_TIMESTAMP_MINUTES = 600;
 export const MICROBIT_HAL_LOG_TIMESTAMP_HOURS = 36000;
 export const MICROBIT_HAL_LOG_TIMESTAMP_DAYS = 864000;
+
+// Sensor register indices, matches microbithal_js.h.
+export const MICROBIT_HAL_SENSOR_ACCELEROMETER_X = 0;
+export const MICROBIT_HAL_SENSOR_ACCELEROMETER_Y = 1;
+export const MICROBIT_HAL_SENSOR_ACCELEROMETER_Z = 2;
+export const MICROBIT_HAL_SENSOR_GESTURE = 3;
+export const MICROBIT_HAL_SENSOR_COMPASS_X = 4;
+export const MICROBIT_HAL_SENSOR_COMPASS_Y = 5;
+export const MICROBIT_HAL_SENSOR_COMPASS_Z = 6;
+export const MICROBIT_HAL_SENSOR_COMPASS_HEADING = 7;
+export const MICROBIT_HAL_SENSOR_TEMPERATURE = 8;
+export const MICROBIT_HAL_SENSOR_LIGHT_LEVEL = 9;
+export const MICROBIT_HAL_SENSOR_SOUND_LEVEL = 10;
+export const MICROBIT_HAL_SENSOR_BUTTON_A = 11;
+export const MICROBIT_HAL_SENSOR_BUTTON_B = 12;
+export const MICROBIT_HAL_SENSOR_PIN_LOGO = 13;
+export const MICROBIT_HAL_SENSOR_PIN_P0 = 14;
+export const MICROBIT_HAL_SENSOR_PIN_P1 = 15;
+export const MICROBIT_HAL_SENSOR_PIN_P2 = 16;
+export const MICROBIT_HAL_SENSOR_COUNT = 17;
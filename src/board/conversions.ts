@@ -94,16 +94,3 @@ export function convertAccelerometerNumberToString(value: number): string {
       throw new Error(`Invalid value ${value}`);
   }
 }
-
-export const convertAudioBuffer = (
-  heap: Uint8Array,
-  source: number,
-  target: AudioBuffer
-) => {
-  const channel = target.getChannelData(0);
-  for (let i = 0; i < channel.length; ++i) {
-    // Convert from uint8 to -1..+1 float.
-    channel[i] = (heap[source + i] / 255) * 2 - 1;
-  }
-  return target;
-};
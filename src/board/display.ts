@@ -14,63 +14,78 @@ export class Display {
     127,
     undefined
   );
-  private state: Array<Array<number>>;
+  // Brightness 0-9 indexed by y * 5 + x.
+  private state = new Uint8Array(25);
+  // The brightness currently shown by each LED.
+  private rendered = new Uint8Array(25);
+  // Bit per LED that might differ from what's rendered.
+  private dirty = 0;
+  private renderRequested = false;
+
   constructor(private leds: SVGElement[]) {
     this.leds = leds;
-    this.state = this.initialState();
-  }
-
-  initialState() {
-    return [
-      [0, 0, 0, 0, 0],
-      [0, 0, 0, 0, 0],
-      [0, 0, 0, 0, 0],
-      [0, 0, 0, 0, 0],
-      [0, 0, 0, 0, 0],
-    ];
   }
 
   /**
-   * This is only used for panic. HAL interactions are via setPixel.
+   * This is only used for panic. HAL interactions are via setFrame.
    */
   show(image: Array<Array<number>>) {
     for (let y = 0; y < 5; ++y) {
       for (let x = 0; x < 5; ++x) {
-        this.state[x][y] = clamp(image[y][x], 0, 9);
+        this.update(y * 5 + x, clamp(image[y][x], 0, 9));
       }
     }
-    this.render();
   }
 
   clear() {
-    this.state = this.initialState();
-    this.render();
+    for (let i = 0; i < 25; ++i) {
+      this.update(i, 0);
+    }
   }
 
-  setPixel(x: number, y: number, value: number) {
-    value = clamp(value, 0, 9);
-    this.state[x][y] = value;
-    this.render();
+  /**
+   * Update the whole display.
+   *
+   * @param frame Brightness 0-9 indexed by y * 5 + x.
+   */
+  setFrame(frame: Uint8Array) {
+    for (let i = 0; i < 25; ++i) {
+      this.update(i, frame[i]);
+    }
   }
 
-  getPixel(x: number, y: number) {
-    return this.state[x][y];
+  private update(i: number, value: number) {
+    if (this.state[i] !== value) {
+      this.state[i] = value;
+      this.dirty |= 1 << i;
+      if (!this.renderRequested) {
+        this.renderRequested = true;
+        requestAnimationFrame(() => {
+          this.renderRequested = false;
+          this.render();
+        });
+      }
+    }
   }
 
-  render() {
-    for (let x = 0; x < 5; ++x) {
-      for (let y = 0; y < 5; ++y) {
-        const on = this.state[x][y];
+  private render() {
+    for (let i = 0; i < 25; ++i) {
+      if (this.dirty & (1 << i) && this.state[i] !== this.rendered[i]) {
+        const on = this.state[i];
+        const x = i % 5;
+        const y = (i - x) / 5;
         const led = this.leds[x * 5 + y];
         if (on) {
-          const bright = brightMap[this.state[x][y]];
+          const bright = brightMap[on];
           led.style.display = "inline";
           led.style.opacity = (bright / 255).toString();
         } else {
           led.style.display = "none";
         }
+        this.rendered[i] = on;
       }
     }
+    this.dirty = 0;
   }
 
   boardStopped() {
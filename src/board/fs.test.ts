@@ -0,0 +1,117 @@
+import { beforeEach, describe, expect, it } from "vitest";
+import { FileSystem } from "./fs";
+
+const sequence = (length: number) =>
+  new Uint8Array(length).map((_, i) => i & 0xff);
+
+const readAll = (fs: FileSystem, idx: number) => {
+  const result = new Uint8Array(fs.size(idx));
+  expect(fs.read(idx, 0, result)).toEqual(result.length);
+  return result;
+};
+
+describe("FileSystem", () => {
+  let fs = new FileSystem();
+
+  beforeEach(() => {
+    fs = new FileSystem();
+  });
+
+  it("creates and finds files", () => {
+    const idx = fs.create("main.py");
+    expect(fs.find("main.py")).toEqual(idx);
+    expect(fs.name(idx)).toEqual("main.py");
+    expect(fs.size(idx)).toEqual(0);
+    expect(fs.find("other.py")).toEqual(-1);
+  });
+
+  it("reads back data written in small appends", () => {
+    const data = sequence(1000);
+    const idx = fs.create("log.txt");
+    for (let i = 0; i < data.length; i += 7) {
+      expect(fs.write(idx, data.subarray(i, i + 7))).toEqual(true);
+    }
+    expect(fs.size(idx)).toEqual(data.length);
+    expect(readAll(fs, idx)).toEqual(data);
+  });
+
+  it("reads from an offset and stops at the end of the file", () => {
+    const data = sequence(300);
+    const idx = fs.create("data");
+    fs.write(idx, data);
+    const target = new Uint8Array(10);
+    expect(fs.read(idx, 295, target)).toEqual(5);
+    expect(target.subarray(0, 5)).toEqual(data.subarray(295));
+    expect(fs.read(idx, 300, target)).toEqual(0);
+  });
+
+  it("truncates existing files on create", () => {
+    const idx = fs.create("main.py");
+    fs.write(idx, sequence(10));
+    expect(fs.create("main.py")).toEqual(idx);
+    expect(fs.size(idx)).toEqual(0);
+  });
+
+  it("reuses space from removed files", () => {
+    const data = sequence(1000);
+    const a = fs.create("a");
+    fs.write(a, data);
+    const b = fs.create("b");
+    fs.write(b, data);
+    fs.remove(a);
+    expect(fs.name(a)).toBeUndefined();
+
+    const c = fs.create("c");
+    for (let i = 0; i < data.length; i += 300) {
+      fs.write(c, data.subarray(i, i + 300));
+    }
+    expect(readAll(fs, c)).toEqual(data);
+    expect(readAll(fs, b)).toEqual(data);
+  });
+
+  it("refuses writes when full", () => {
+    const idx = fs.create("big");
+    expect(fs.write(idx, new Uint8Array(31 * 1024))).toEqual(true);
+    expect(fs.write(idx, new Uint8Array(1024))).toEqual(false);
+    expect(fs.size(idx)).toEqual(31 * 1024);
+    fs.remove(idx);
+    expect(fs.write(fs.create("small"), new Uint8Array(1024))).toEqual(true);
+  });
+
+  it("allows forced writes beyond the limit", () => {
+    const data = sequence(40 * 1024);
+    const idx = fs.create("main.py");
+    expect(fs.write(idx, data, true)).toEqual(true);
+    expect(readAll(fs, idx)).toEqual(data);
+  });
+
+  it("lists file names and reuses slots of removed files", () => {
+    const a = fs.create("a");
+    fs.create("b");
+    fs.create("c");
+    fs.remove(a);
+    expect(fs.names()).toEqual(["b", "c"]);
+    expect(fs.create("d")).toEqual(a);
+    expect(fs.find("a")).toEqual(-1);
+    expect(fs.find("d")).toEqual(a);
+    expect(fs.names()).toEqual(["d", "b", "c"]);
+  });
+
+  it("changes the content key when a file changes", () => {
+    const idx = fs.create("main.py");
+    fs.write(idx, sequence(200));
+    const key = fs.contentKey(idx);
+    expect(fs.contentKey(idx)).toEqual(key);
+    fs.write(idx, sequence(1));
+    expect(fs.contentKey(idx)).not.toEqual(key);
+    fs.create("main.py");
+    fs.write(idx, sequence(200));
+    expect(fs.contentKey(idx)).toEqual(key);
+  });
+
+  it("clears all files", () => {
+    fs.write(fs.create("a"), sequence(10));
+    fs.clear();
+    expect(fs.find("a")).toEqual(-1);
+  });
+});
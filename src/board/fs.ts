@@ -1,42 +1,62 @@
 // Size as per C implementation.
 const maxSize = 31.5 * 1024;
 
+// Like microbitfs on the device, file data is stored in fixed size chunks
+// carved out of a single flash-sized arena. A file is a list of chunks so
+// appends never copy existing data.
+const chunkSize = 128;
+const maxChunks = maxSize / chunkSize;
+
 export class FileSystem {
   // Each entry is an FsFile object. The indexes are used as identifiers.
-  // When a file is deleted the entry becomes ['', null] and can be reused.
+  // When a file is deleted the entry becomes null and can be reused.
   private _content: Array<FsFile | null> = [];
-  private _size = 0;
+  // Maps file names to their index in _content.
+  private index = new Map<string, number>();
+  // Indexes of null entries in _content.
+  private freeSlots: number[] = [];
+  private arena = new Uint8Array(maxSize);
+  // Chunks released by removed or truncated files.
+  private freeChunks: number[] = [];
+  // Chunks from here to the end of the arena have never been allocated.
+  private nextChunk = 0;
+  private usedChunks = 0;
 
   create(name: string) {
-    let free_idx = -1;
-    for (let idx = 0; idx < this._content.length; ++idx) {
-      const entry = this._content[idx];
-      if (entry === null) {
-        free_idx = idx;
-      } else if (entry.name === name) {
-        // Truncate existing file and return it.
-        entry.truncate();
-        return idx;
-      }
+    const existing = this.index.get(name);
+    if (existing !== undefined) {
+      // Truncate existing file and return it.
+      this.releaseChunks(this._content[existing]!);
+      return existing;
     }
-    if (free_idx < 0) {
+    let idx = this.freeSlots.pop();
+    if (idx === undefined) {
       // Add a new file and return it.
+      idx = this._content.length;
       this._content.push(new FsFile(name));
-      return this._content.length - 1;
     } else {
       // Reuse existing slot for the new file.
-      this._content[free_idx] = new FsFile(name);
-      return free_idx;
+      this._content[idx] = new FsFile(name);
     }
+    this.index.set(name, idx);
+    return idx;
   }
 
   find(name: string) {
-    for (let idx = 0; idx < this._content.length; ++idx) {
-      if (this._content[idx]?.name === name) {
-        return idx;
+    return this.index.get(name) ?? -1;
+  }
+
+  /**
+   * The names of all files, in index order.
+   */
+  names(): string[] {
+    const result: string[] = [];
+    for (const file of this._content) {
+      if (file) {
+        result.push(file.name);
       }
     }
-    return -1;
+    return result;
   }
 
   name(idx: number) {
@@ -49,66 +69,182 @@ export class FileSystem {
     if (!file) {
       throw new Error("File must exist");
     }
-    return file.size();
+    return file.size;
+  }
+
+  /**
+   * A key that identifies the name and content of a file.
+   *
+   * Used to look up compiled code for the file.
+   */
+  contentKey(idx: number): string {
+    const file = this._content[idx];
+    if (!file) {
+      throw new Error("File must exist");
+    }
+    if (file.hash === undefined) {
+      // A 53-bit hash (cyrb53) as we only need to detect edits.
+      let h1 = 0xdeadbeef;
+      let h2 = 0x41c6ce57;
+      for (let position = 0; position < file.size; position += chunkSize) {
+        const start = file.chunks[position / chunkSize] * chunkSize;
+        const end = start + Math.min(chunkSize, file.size - position);
+        for (let i = start; i < end; ++i) {
+          const b = this.arena[i];
+          h1 = Math.imul(h1 ^ b, 2654435761);
+          h2 = Math.imul(h2 ^ b, 1597334677);
+        }
+      }
+      h1 = Math.imul(h1 ^ (h1 >>> 16), 2246822507);
+      h1 ^= Math.imul(h2 ^ (h2 >>> 13), 3266489909);
+      h2 = Math.imul(h2 ^ (h2 >>> 16), 2246822507);
+      h2 ^= Math.imul(h1 ^ (h1 >>> 13), 3266489909);
+      const hash = 4294967296 * (2097151 & h2) + (h1 >>> 0);
+      file.hash = `${file.size}:${hash.toString(36)}`;
+    }
+    return `${file.name}:${file.hash}`;
   }
 
   remove(idx: number) {
     const file = this._content[idx];
     if (file) {
-      this._size -= file.size();
+      this.releaseChunks(file);
       this._content[idx] = null;
+      this.index.delete(file.name);
+      this.freeSlots.push(idx);
     }
   }
 
-  readbyte(idx: number, offset: number) {
+  /**
+   * Copy file data starting at offset into target.
+   *
+   * @returns the number of bytes copied, 0 at the end of the file.
+   */
+  read(idx: number, offset: number, target: Uint8Array): number {
     const file = this._content[idx];
-    return file ? file.readbyte(offset) : -1;
+    if (!file) {
+      return 0;
+    }
+    const end = Math.min(file.size, offset + target.length);
+    let position = offset;
+    while (position < end) {
+      const within = position % chunkSize;
+      const start = file.chunks[(position - within) / chunkSize] * chunkSize;
+      const length = Math.min(chunkSize - within, end - position);
+      target.set(
+        this.arena.subarray(start + within, start + within + length),
+        position - offset
+      );
+      position += length;
+    }
+    return Math.max(0, end - offset);
   }
 
+  /**
+   * Append data to a file.
+   *
+   * @param force Ignore the flash size limit. Used when flashing.
+   * @returns false if there is insufficient space.
+   */
   write(idx: number, data: Uint8Array, force: boolean = false): boolean {
     const file = this._content[idx];
     if (!file) {
       throw new Error("File must exist");
     }
-    if (!force && this._size + data.length > maxSize) {
+    const required =
+      Math.ceil((file.size + data.length) / chunkSize) - file.chunks.length;
+    if (!force && this.usedChunks + required > maxChunks) {
       return false;
     }
-    this._size += data.length;
-    file.append(data);
+
+    // Top up the partially filled last chunk.
+    let written = 0;
+    const within = file.size % chunkSize;
+    if (within !== 0) {
+      const last = file.chunks[file.chunks.length - 1];
+      written = Math.min(chunkSize - within, data.length);
+      this.arena.set(data.subarray(0, written), last * chunkSize + within);
+    }
+    // Then whole chunks. When nothing has been freed the new chunks are
+    // contiguous so we can copy the remaining data in one go.
+    if (required > 0) {
+      if (this.freeChunks.length === 0) {
+        const first = this.allocateContiguous(required);
+        for (let i = 0; i < required; ++i) {
+          file.chunks.push(first + i);
+        }
+        this.arena.set(data.subarray(written), first * chunkSize);
+      } else {
+        while (written < data.length) {
+          const chunk = this.allocate();
+          file.chunks.push(chunk);
+          const length = Math.min(chunkSize, data.length - written);
+          this.arena.set(
+            data.subarray(written, written + length),
+            chunk * chunkSize
+          );
+          written += length;
+        }
+      }
+    }
+    file.size += data.length;
+    file.hash = undefined;
     return true;
   }
 
   clear() {
-    for (let idx = 0; idx < this._content.length; ++idx) {
-      this.remove(idx);
-    }
+    this._content.length = 0;
+    this.index.clear();
+    this.freeSlots.length = 0;
+    this.freeChunks.length = 0;
+    this.nextChunk = 0;
+    this.usedChunks = 0;
   }
 
   toString() {
     return this._content.toString();
   }
-}
-
-const EMPTY_ARRAY = new Uint8Array(0);
 
-class FsFile {
-  constructor(public name: string, private buffer: Uint8Array = EMPTY_ARRAY) {}
-  readbyte(offset: number) {
-    if (offset < this.buffer.length) {
-      return this.buffer[offset];
+  private allocate(): number {
+    const chunk = this.freeChunks.pop();
+    if (chunk !== undefined) {
+      this.usedChunks++;
+      return chunk;
     }
-    return -1;
-  }
-  append(data: Uint8Array) {
-    const updated = new Uint8Array(this.buffer.length + data.length);
-    updated.set(this.buffer);
-    updated.set(data, this.buffer.length);
-    this.buffer = updated;
+    return this.allocateContiguous(1);
   }
-  truncate() {
-    this.buffer = EMPTY_ARRAY;
+
+  private allocateContiguous(count: number): number {
+    const arenaChunks = this.arena.length / chunkSize;
+    if (this.nextChunk + count > arenaChunks) {
+      // Only reachable via a forced write when flashing.
+      const grown = new Uint8Array(
+        Math.max(this.arena.length * 2, (this.nextChunk + count) * chunkSize)
+      );
+      grown.set(this.arena);
+      this.arena = grown;
+    }
+    const first = this.nextChunk;
+    this.nextChunk += count;
+    this.usedChunks += count;
+    return first;
   }
-  size() {
-    return this.buffer.length;
+
+  private releaseChunks(file: FsFile) {
+    this.usedChunks -= file.chunks.length;
+    for (const chunk of file.chunks) {
+      this.freeChunks.push(chunk);
+    }
+    file.chunks.length = 0;
+    file.size = 0;
+    file.hash = undefined;
   }
 }
+
+class FsFile {
+  chunks: number[] = [];
+  size: number = 0;
+  // Cached content hash, see contentKey.
+  hash: string | undefined;
+  constructor(public name: string) {}
+}
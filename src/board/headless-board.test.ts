@@ -0,0 +1,154 @@
+import { describe, expect, it } from "vitest";
+import { VirtualClock } from "./clock";
+import {
+  MICROBIT_HAL_MICROPHONE_EVT_THRESHOLD_HIGH,
+  MICROBIT_HAL_MICROPHONE_EVT_THRESHOLD_LOW,
+} from "./constants";
+import { HeadlessBoard } from "./headless-board";
+import { readTrace, TracePlayer, TraceRecorder } from "./trace";
+
+type HalBoard = Pick<
+  HeadlessBoard,
+  "ticksMilliseconds" | "sleep" | "shouldYield" | "readSerialInput"
+>;
+
+// Polls for input as the HAL does, yielding once 5ms have passed.
+const runHal = (board: HalBoard, polls: number) => {
+  const seen: string[] = [];
+  const input = new Uint8Array(1);
+  let lastYieldMs = board.ticksMilliseconds();
+  for (let poll = 0; poll < polls; poll++) {
+    if (board.readSerialInput(input, 3) > 0) {
+      seen.push(`${String.fromCharCode(input[0])} at ${poll}`);
+    }
+    if (board.shouldYield(board.ticksMilliseconds() - lastYieldMs >= 5)) {
+      board.sleep(0);
+      lastYieldMs = board.ticksMilliseconds();
+    }
+  }
+  return seen;
+};
+
+describe("HeadlessBoard", () => {
+  it("sets values by the set_value ids", () => {
+    const board = new HeadlessBoard();
+    board.setValue("temperature", 30);
+    board.setValue("gesture", "shake");
+    board.setValue("pin0", 1);
+    const state = board.getState();
+    expect(state.temperature.value).toEqual(30);
+    expect(state.gesture.value).toEqual("shake");
+    expect(state.pin0.value).toEqual(1);
+    expect(() => board.setValue("nonsense", 1)).toThrow();
+  });
+
+  it("counts button presses", () => {
+    const board = new HeadlessBoard();
+    board.setValue("buttonA", 1);
+    board.setValue("buttonA", 0);
+    board.setValue("buttonA", 1);
+    expect(board.buttons[0].getAndClearPresses()).toEqual(2);
+    expect(board.buttons[0].getAndClearPresses()).toEqual(0);
+  });
+
+  it("reports sound level threshold crossings", () => {
+    const board = new HeadlessBoard();
+    const events: number[] = [];
+    board.microphone.initializeCallbacks((e) => events.push(e));
+    board.microphone.setThreshold("high", 300);
+    board.setValue("soundLevel", 255);
+    board.setValue("soundLevel", 100);
+    board.microphone.setThreshold("high", 200);
+    board.setValue("soundLevel", 220);
+    board.setValue("soundLevel", 10);
+    expect(events).toEqual([
+      MICROBIT_HAL_MICROPHONE_EVT_THRESHOLD_HIGH,
+      MICROBIT_HAL_MICROPHONE_EVT_THRESHOLD_HIGH,
+      MICROBIT_HAL_MICROPHONE_EVT_THRESHOLD_LOW,
+    ]);
+    expect(() => board.setValue("soundLevel", 256)).toThrow();
+  });
+
+  it("captures display changes as images", () => {
+    const board = new HeadlessBoard();
+    board.initialize();
+    const frame = new Uint8Array(25);
+    frame[0] = 9;
+    board.display.setFrame(frame);
+    board.display.setFrame(frame);
+    frame[24] = 5;
+    board.display.setFrame(frame);
+    expect(board.output.display.map((f) => f.image)).toEqual([
+      "90000:00000:00000:00000:00000",
+      "90000:00000:00000:00000:00005",
+    ]);
+  });
+
+  it("drops serial output once stopping", () => {
+    const board = new HeadlessBoard();
+    board.writeSerialOutput("hello");
+    board.requestStop();
+    board.writeSerialOutput("KeyboardInterrupt");
+    expect(board.output.serial).toEqual("hello");
+  });
+
+  it("fast-forwards sleeps with a virtual clock", () => {
+    const board = new HeadlessBoard(new VirtualClock());
+    board.initialize();
+    expect(board.sleep(1000)).toEqual(false);
+    expect(board.ticksMilliseconds()).toEqual(1000);
+    board.readSerialInput(new Uint8Array(1), 3);
+    expect(board.ticksMicroseconds()).toBeGreaterThan(1000_000);
+  });
+
+  it("replays a trace recorded against a real-time clock", () => {
+    // Stands in for Board, with a clock that moves unevenly between reads
+    // and typing that arrives while the HAL is yielded.
+    let nowUs = 0;
+    let yields = 0;
+    let typed = "";
+    const recorder = new TraceRecorder(() => nowUs);
+    const live: HalBoard = {
+      ticksMilliseconds() {
+        nowUs += 1 + ((nowUs * 7919) % 997);
+        return Math.floor(nowUs / 1000);
+      },
+      shouldYield(due: boolean) {
+        recorder.polled(due);
+        return due;
+      },
+      sleep() {
+        recorder.yielded();
+        if (++yields % 3 === 0) {
+          const data = String.fromCharCode(97 + (yields % 26));
+          recorder.record({ kind: "serial_input", data });
+          typed += data;
+        }
+        return true;
+      },
+      readSerialInput(target: Uint8Array) {
+        if (!typed) {
+          return 0;
+        }
+        target[0] = typed.charCodeAt(0);
+        typed = typed.slice(1);
+        return 1;
+      },
+    };
+    const recorded = runHal(live, 2000);
+    expect(recorded.length).toBeGreaterThan(10);
+
+    const replay = (events: ReturnType<typeof readTrace>) => {
+      const board = new HeadlessBoard(new VirtualClock());
+      board.player = new TracePlayer(events);
+      board.initialize();
+      return runHal(board, 2000);
+    };
+    const events = readTrace(recorder.toBytes());
+    expect(replay(events)).toEqual(recorded);
+    // Virtual time alone yields at different points.
+    expect(replay(events.filter((e) => e.kind !== "yield"))).not.toEqual(
+      recorded
+    );
+  });
+});
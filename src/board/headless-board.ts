@@ -0,0 +1,401 @@
+import { LogEntry } from ".";
+import { Accelerometer } from "./accelerometer";
+import { StubButton } from "./buttons";
+import { Clock, RealClock, VirtualClock } from "./clock";
+import { Compass } from "./compass";
+import {
+  MICROBIT_HAL_PIN_FACE,
+  MICROBIT_HAL_PIN_P0,
+  MICROBIT_HAL_PIN_P1,
+  MICROBIT_HAL_PIN_P2,
+} from "./constants";
+import { DataLogging } from "./data-logging";
+import { StubMicrophone } from "./microphone";
+import { StubPin } from "./pins";
+import { Radio } from "./radio";
+import { SerialInputBuffer } from "./serial-input";
+import { randomWord, TracePlayer } from "./trace";
+import { RangeSensor, State } from "./state";
+import {
+  EmscriptenModule,
+  ModuleWrapper,
+  PanicError,
+  ResetError,
+  setSensorValue,
+  writeSensorRegisters,
+} from "./wasm";
+
+/**
+ * Output captured while running headless.
+ *
+ * Times are milliseconds since the program started.
+ */
+export interface HeadlessOutput {
+  serial: string;
+  // Each frame in the format used by the Image constructor, e.g. "09090:...".
+  display: { timeMs: number; image: string }[];
+  radio: { timeMs: number; data: number[] }[];
+  log: LogEntry[];
+}
+
+// Virtual time that passes each time the HAL polls for events, roughly the
+// time a device takes to run the 256 bytecodes between polls.
+const virtualPollMs = 0.05;
+
+/**
+ * The board as seen by the HAL when running without a DOM, e.g. in Node.
+ *
+ * Mirrors the parts of Board that jshal.js uses. Inputs are set via setValue
+ * with the same ids as the "set_value" message and outputs are captured.
+ *
+ * With a VirtualClock, sleeps advance the clock rather than waiting and busy
+ * code advances it a fixed amount per poll, so runs are fast and repeatable.
+ */
+export class HeadlessBoard {
+  display: HeadlessDisplay;
+  buttons: StubButton[];
+  pins: StubPin[];
+  audio: HeadlessAudio;
+  temperature: RangeSensor;
+  lightLevel: RangeSensor;
+  microphone: StubMicrophone;
+  accelerometer: Accelerometer;
+  compass: Compass;
+  radio: Radio;
+  dataLogging: DataLogging;
+
+  output: HeadlessOutput = { serial: "", display: [], radio: [], log: [] };
+
+  /**
+   * Defined while a program is running.
+   */
+  module: ModuleWrapper | undefined;
+
+  /**
+   * Called when main.py finishes and the REPL would take over.
+   */
+  onProgramFinished: (() => void) | undefined;
+
+  /**
+   * Replays a recorded trace in place of live inputs.
+   *
+   * The HAL yields between events where it did when recorded, and inputs are
+   * delivered at the same yield. Use with a VirtualClock, which then moves on
+   * to the recorded time at each of those points.
+   */
+  player: TracePlayer | undefined;
+  private yields = 0;
+
+  private epoch: number | undefined;
+  private serialInput = new SerialInputBuffer();
+  private stopping = false;
+
+  constructor(readonly clock: Clock = new RealClock()) {
+    const currentTimeMillis = this.ticksMilliseconds.bind(this);
+    const onChange = () => {};
+    this.display = new HeadlessDisplay((image) =>
+      this.output.display.push({ timeMs: currentTimeMillis(), image })
+    );
+    this.buttons = [
+      new StubButton("buttonA"),
+      new StubButton("buttonB"),
+    ];
+    this.pins = Array.from(Array(33), (_, i) => new StubPin(`pin${i}`));
+    this.audio = new HeadlessAudio(clock);
+    this.temperature = new RangeSensor("temperature", -5, 50, 21, "°C");
+    this.lightLevel = new RangeSensor("lightLevel", 0, 255, 127, undefined);
+    this.microphone = new StubMicrophone();
+    this.accelerometer = new Accelerometer(onChange);
+    this.compass = new Compass();
+    this.radio = new Radio(
+      (data) =>
+        this.output.radio.push({
+          timeMs: currentTimeMillis(),
+          data: Array.from(data),
+        }),
+      onChange,
+      currentTimeMillis
+    );
+    this.dataLogging = new DataLogging(
+      currentTimeMillis,
+      (entry) => this.output.log.push(entry),
+      (text) => this.writeSerialOutput(text),
+      () => (this.output.log.length = 0),
+      onChange
+    );
+  }
+
+  /**
+   * Connect the callbacks into a newly created module.
+   */
+  initializeCallbacks(wrapped: EmscriptenModule) {
+    this.audio.initializeCallbacks(
+      wrapped._microbit_hal_audio_ready_callback,
+      wrapped._microbit_hal_audio_speech_ready_callback,
+      wrapped._microbit_hal_audio_expression_ready_callback
+    );
+    this.accelerometer.initializeCallbacks(
+      wrapped._microbit_hal_gesture_callback
+    );
+    this.microphone.initializeCallbacks(
+      wrapped._microbit_hal_level_detector_callback
+    );
+  }
+
+  getState(): Omit<State, "radio" | "dataLogging"> {
+    return {
+      buttonA: this.buttons[0].state,
+      buttonB: this.buttons[1].state,
+      pinLogo: this.pins[MICROBIT_HAL_PIN_FACE].state,
+      pin0: this.pins[MICROBIT_HAL_PIN_P0].state,
+      pin1: this.pins[MICROBIT_HAL_PIN_P1].state,
+      pin2: this.pins[MICROBIT_HAL_PIN_P2].state,
+      ...this.accelerometer.state,
+      ...this.compass.state,
+      lightLevel: this.lightLevel,
+      soundLevel: this.microphone.soundLevel,
+      temperature: this.temperature,
+    };
+  }
+
+  /**
+   * Set a sensor, button or pin value. See Board.setValue.
+   */
+  setValue(id: string, value: any) {
+    if (!setSensorValue(this, id, value)) {
+      throw new Error(`Unknown sensor: ${id}`);
+    }
+    this.syncSensorRegisters();
+  }
+
+  writeSerialInput(text: string) {
+    this.serialInput.writeText(text);
+  }
+
+  /**
+   * Stop the program and the REPL, as Board.stop does.
+   */
+  requestStop() {
+    this.stopping = true;
+    this.module?.requestStop();
+    // Ctrl-C, Ctrl-D to interrupt the main loop.
+    this.writeSerialInput("\x03\x04");
+  }
+
+  receiveRadio(data: Uint8Array) {
+    // As for a real radio, anything sent while we're disabled is lost.
+    if (this.radio.state.enabled) {
+      this.radio.receive(data);
+    }
+  }
+
+  ticksMilliseconds() {
+    return Math.floor(this.ticksMicroseconds() / 1000);
+  }
+
+  ticksMicroseconds() {
+    return Math.floor((this.clock.now() - this.epoch!) * 1000);
+  }
+
+  sleep(ms: number): boolean {
+    this.yields++;
+    this.player?.yielded();
+    let sleep = true;
+    if (this.clock instanceof VirtualClock) {
+      this.clock.advance(ms);
+      sleep = false;
+    }
+    this.replayInputs();
+    return sleep;
+  }
+
+  shouldYield(due: boolean): boolean {
+    if (!this.player?.hasYields()) {
+      return due;
+    }
+    const recordedUs = this.player.polled();
+    if (recordedUs === undefined) {
+      return false;
+    }
+    this.catchUp(recordedUs);
+    return true;
+  }
+
+  randomWord(): number {
+    return this.player?.nextRandomWord() ?? randomWord();
+  }
+
+  private replayInputs() {
+    if (!this.player) {
+      return;
+    }
+    for (const event of this.player.takeInputs(this.yields)) {
+      this.catchUp(event.timeUs);
+      switch (event.kind) {
+        case "set_value":
+          this.setValue(event.id, event.value);
+          break;
+        case "serial_input":
+          this.writeSerialInput(event.data);
+          break;
+        case "radio_input":
+          this.receiveRadio(event.data);
+          break;
+      }
+    }
+  }
+
+  /**
+   * Move virtual time on to a recorded time if the replay got there faster.
+   */
+  private catchUp(timeUs: number) {
+    const behindUs = timeUs - this.ticksMicroseconds();
+    if (this.clock instanceof VirtualClock && behindUs > 0) {
+      this.clock.advance(behindUs / 1000);
+    }
+  }
+
+  /**
+   * Read serial input into target, see SerialInputBuffer.read.
+   *
+   * The HAL calls this every time it processes events so we also advance
+   * virtual time here, unless we're following recorded yields.
+   */
+  readSerialInput(target: Uint8Array, interruptChar: number): number {
+    if (this.clock instanceof VirtualClock && !this.player?.hasYields()) {
+      this.clock.advance(virtualPollMs);
+    }
+    return this.serialInput.read(target, interruptChar);
+  }
+
+  writeSerialOutput(text: string): boolean {
+    // Avoid the Ctrl-C, Ctrl-D output when we request a stop.
+    if (!this.stopping) {
+      this.output.serial += text;
+    }
+    // Back off where the recorded run did.
+    return this.player?.serialWritten() ?? false;
+  }
+
+  throwPanic(code: number): void {
+    throw new PanicError(code);
+  }
+
+  throwReset(): void {
+    throw new ResetError();
+  }
+
+  programFinished() {
+    this.onProgramFinished?.();
+  }
+
+  gcCollected() {
+    // See HeadlessResult for the totals.
+  }
+
+  initialize() {
+    this.epoch = this.clock.now();
+    this.yields = 0;
+    this.replayInputs();
+    this.syncSensorRegisters();
+  }
+
+  stopComponents() {
+    this.buttons.forEach((b) => b.boardStopped());
+    this.pins.forEach((p) => p.boardStopped());
+    this.audio.boardStopped();
+    this.accelerometer.boardStopped();
+    this.radio.boardStopped();
+    this.dataLogging.boardStopped();
+    this.serialInput.clear();
+  }
+
+  private syncSensorRegisters() {
+    if (this.module) {
+      writeSensorRegisters(this.module.sensorRegisters, this.getState());
+    }
+  }
+}
+
+class HeadlessDisplay {
+  private image: string | undefined;
+
+  constructor(private onFrame: (image: string) => void) {}
+
+  setFrame(frame: Uint8Array) {
+    const rows = [];
+    for (let y = 0; y < 5; y++) {
+      rows.push(frame.subarray(y * 5, y * 5 + 5).join(""));
+    }
+    const image = rows.join(":");
+    // The HAL only sends changes but a frame can be set back and forth.
+    if (image !== this.image) {
+      this.image = image;
+      this.onFrame(image);
+    }
+  }
+}
+
+/**
+ * Discards audio but paces requests for more as if it were played, so that
+ * code waiting on music, speech or sound expressions completes at the pace
+ * of the clock.
+ */
+class HeadlessAudio {
+  default: HeadlessBufferedAudio;
+  speech: HeadlessBufferedAudio;
+  soundExpression: HeadlessBufferedAudio;
+
+  constructor(clock: Clock) {
+    this.default = new HeadlessBufferedAudio(clock);
+    this.speech = new HeadlessBufferedAudio(clock);
+    this.soundExpression = new HeadlessBufferedAudio(clock);
+  }
+
+  initializeCallbacks(
+    defaultAudioCallback: () => void,
+    speechAudioCallback: () => void,
+    expressionAudioCallback: () => void
+  ) {
+    this.default.callback = defaultAudioCallback;
+    this.speech.callback = speechAudioCallback;
+    this.soundExpression.callback = expressionAudioCallback;
+  }
+
+  setVolume(volume: number) {}
+
+  setPeriodUs(periodUs: number) {}
+
+  setAmplitudeU10(amplitudeU10: number) {}
+
+  boardStopped() {
+    this.default.boardStopped();
+    this.speech.boardStopped();
+    this.soundExpression.boardStopped();
+  }
+}
+
+class HeadlessBufferedAudio {
+  callback: (() => void) | undefined;
+  private sampleRate = 0;
+  private cancel: (() => void) | undefined;
+
+  constructor(private clock: Clock) {}
+
+  init(sampleRate: number) {
+    this.sampleRate = sampleRate;
+  }
+
+  writeSamples(samples: Float32Array) {
+    const durationMs = (samples.length / this.sampleRate) * 1000;
+    this.cancel = this.clock.schedule(() => {
+      this.cancel = undefined;
+      this.callback?.();
+    }, durationMs);
+  }
+
+  boardStopped() {
+    this.cancel?.();
+    this.cancel = undefined;
+  }
+}
@@ -2,6 +2,7 @@ import svgText from "../microbit-drawing.svg";
 import { Accelerometer } from "./accelerometer";
 import { Audio } from "./audio";
 import { Button } from "./buttons";
+import { BytecodeCache } from "./bytecode-cache";
 import { Compass } from "./compass";
 import {
   MICROBIT_HAL_PIN_FACE,
@@ -32,8 +33,24 @@ import { FileSystem } from "./fs";
 import { Microphone } from "./microphone";
 import { Pin, StubPin, TouchPin } from "./pins";
 import { Radio } from "./radio";
+import { SerialInputBuffer } from "./serial-input";
+import { SerialOutputBuffer } from "./serial-output";
 import { RangeSensor, State } from "./state";
-import { ModuleWrapper } from "./wasm";
+import { randomWord, stateInputs, TraceInput, TraceRecorder } from "./trace";
+import {
+  defaultHeapSize,
+  EmscriptenModule,
+  GcStats,
+  gcStatsIntervalMs,
+  ModuleWrapper,
+  PanicError,
+  ResetError,
+  setSensorValue,
+  validHeapSize,
+  writeSensorRegisters,
+} from "./wasm";
+import { CompiledWasm, compileWasm } from "./wasm-cache";
+import { WorkerModule } from "./worker-module";
 
 enum StopKind {
   /**
@@ -61,27 +78,40 @@ enum StopKind {
   UserStop = "user",
 }
 
-export class PanicError extends Error {
-  constructor(public code: number) {
-    super("panic");
-  }
-}
+const stoppedOpactity = "0.5";
 
-export class ResetError extends Error {
-  constructor() {
-    super("reset");
-  }
-}
+/**
+ * The name of the Emscripten build to load from the build directory.
+ *
+ * "firmware-jspi" is built by "make jspi" and needs a browser with
+ * JavaScript Promise Integration.
+ */
+export type Firmware = "firmware" | "firmware-jspi";
 
-const stoppedOpactity = "0.5";
+export interface BoardOptions {
+  firmware: Firmware;
+  /**
+   * Run MicroPython in a worker if supported.
+   */
+  worker: boolean;
+  /**
+   * Persist the compiled firmware keyed by this version, if supported.
+   */
+  wasmCacheVersion: string | undefined;
+}
 
-export function createBoard(notifications: Notifications, fs: FileSystem) {
+export function createBoard(
+  notifications: Notifications,
+  fs: FileSystem,
+  bytecodeCache: BytecodeCache,
+  options: BoardOptions
+) {
   document.body.insertAdjacentHTML("afterbegin", svgText);
   const svg = document.querySelector("svg");
   if (!svg) {
     throw new Error("No SVG");
   }
-  return new Board(notifications, fs, svg);
+  return new Board(notifications, fs, bytecodeCache, svg, options);
 }
 
 export class Board {
@@ -100,7 +130,28 @@ export class Board {
   radio: Radio;
   dataLogging: DataLogging;
 
-  public serialInputBuffer: number[] = [];
+  public serialInputBuffer = new SerialInputBuffer();
+  /**
+   * Coalesces serial output into fewer messages to the embedder.
+   */
+  serialOutput: SerialOutputBuffer;
+  /**
+   * Record a trace of each run's inputs, set via the "config" message.
+   *
+   * Not supported in worker mode where inputs reach the program
+   * asynchronously.
+   */
+  recordTrace = false;
+  /**
+   * The MicroPython heap size for the next start, set via the "config"
+   * message.
+   */
+  heapSize = defaultHeapSize;
+  /**
+   * Defined while a run is being recorded.
+   */
+  private recorder: TraceRecorder | undefined;
+  private lastGcStatsMs = -Infinity;
 
   private stoppedOverlay: HTMLDivElement;
   private playButton: HTMLButtonElement;
@@ -130,11 +181,23 @@ export class Board {
   /**
    * Defined during start().
    */
-  private modulePromise: Promise<ModuleWrapper> | undefined;
+  private modulePromise: Promise<ModuleWrapper | WorkerModule> | undefined;
   /**
    * Defined during start().
    */
-  private module: ModuleWrapper | undefined;
+  private module: ModuleWrapper | WorkerModule | undefined;
+  /**
+   * A module whose last run stopped cleanly, kept to restart in place.
+   */
+  private idleModule: ModuleWrapper | undefined;
+  /**
+   * Defined if MicroPython runs in a worker rather than on this thread.
+   */
+  private worker: WorkerModule | undefined;
+  /**
+   * Loads the firmware when running on this thread.
+   */
+  private firmwarePromise: Promise<void> | undefined;
   /**
    * Controls the action after the user program completes.
    *
@@ -153,12 +216,22 @@ export class Board {
   constructor(
     private notifications: Notifications,
     private fs: FileSystem,
-    private svg: SVGElement
+    private bytecodeCache: BytecodeCache,
+    private svg: SVGElement,
+    options: BoardOptions
   ) {
     this.display = new Display(
       Array.from(this.svg.querySelector("#LEDsOn")!.querySelectorAll("use"))
     );
-    const onChange = this.notifications.onStateChange;
+    const onChange = (change: Partial<State>) => {
+      // Buttons and pins can also be changed via the board itself.
+      const { buttonA, buttonB, pinLogo, pin0, pin1, pin2 } = change;
+      this.recordInputs(
+        stateInputs({ buttonA, buttonB, pinLogo, pin0, pin1, pin2 })
+      );
+      this.syncSensorRegisters();
+      this.notifications.onStateChange(change);
+    };
     this.buttons = [
       new Button(
         "buttonA",
@@ -211,6 +284,9 @@ export class Board {
       onChange
     );
 
+    this.serialOutput = new SerialOutputBuffer(
+      this.notifications.onSerialOutput
+    );
     const currentTimeMillis = this.ticksMilliseconds.bind(this);
     this.radio = new Radio(
       this.notifications.onRadioOutput.bind(this.notifications),
@@ -220,7 +296,7 @@ export class Board {
     this.dataLogging = new DataLogging(
       currentTimeMillis,
       this.notifications.onLogOutput,
-      this.notifications.onSerialOutput,
+      (text) => this.serialOutput.write(text),
       this.notifications.onLogDelete,
       onChange
     );
@@ -235,22 +311,73 @@ export class Board {
       this.notifications.onRequestFlash();
     });
 
+    // Without cross-origin isolation we fall back to running on this thread.
+    if (options.worker && WorkerModule.isSupported()) {
+      this.worker = new WorkerModule(
+        this,
+        this.notifications,
+        options.firmware,
+        this.bytecodeCache.persistent,
+        options.wasmCacheVersion
+      );
+    } else {
+      this.firmwarePromise = loadFirmware(
+        options.firmware,
+        options.wasmCacheVersion
+      );
+    }
+
     this.updateTranslationsInternal();
     this.notifications.onReady(this.getState());
   }
 
-  private async createModule(): Promise<ModuleWrapper> {
+  private async createModule(): Promise<ModuleWrapper | WorkerModule> {
+    const worker = this.worker;
+    if (worker) {
+      this.audio.initializeCallbacks({
+        defaultAudioCallback: () => worker.audioReadyCallback("default"),
+        speechAudioCallback: () => worker.audioReadyCallback("speech"),
+        expressionAudioCallback: () =>
+          worker.audioReadyCallback("soundExpression"),
+      });
+      this.accelerometer.initializeCallbacks(worker.gestureCallback);
+      this.microphone.initializeCallbacks(worker.levelDetectorCallback);
+      return worker.initialize();
+    }
+    if (this.idleModule) {
+      // Skip instantiation and runtime init. Stopping disposed of the audio
+      // sinks so connect the callbacks again.
+      const module = this.idleModule;
+      this.idleModule = undefined;
+      this.initializeCallbacks(module.module);
+      return module;
+    }
+    await Promise.all([
+      this.firmwarePromise,
+      this.bytecodeCache.load(async () => (await compiledWasmPromise).build),
+    ]);
     const wrapped = await window.createModule({
       board: this,
       fs: this.fs,
+      bytecodeCache: this.bytecodeCache,
       conversions,
       noInitialRun: true,
       instantiateWasm,
     });
     const module = new ModuleWrapper(wrapped);
+    this.initializeCallbacks(wrapped);
+    return module;
+  }
+
+  /**
+   * Connect the callbacks into a module that's about to run.
+   */
+  private initializeCallbacks(wrapped: EmscriptenModule) {
     this.audio.initializeCallbacks({
       defaultAudioCallback: wrapped._microbit_hal_audio_ready_callback,
       speechAudioCallback: wrapped._microbit_hal_audio_speech_ready_callback,
+      expressionAudioCallback:
+        wrapped._microbit_hal_audio_expression_ready_callback,
     });
     this.accelerometer.initializeCallbacks(
       wrapped._microbit_hal_gesture_callback
@@ -258,7 +385,6 @@ export class Board {
     this.microphone.initializeCallbacks(
       wrapped._microbit_hal_level_detector_callback
     );
-    return module;
   }
 
   updateTranslations(language: string, translations: Record<string, string>) {
@@ -304,62 +430,50 @@ export class Board {
   }
 
   setValue(id: string, value: any) {
-    switch (id) {
-      case "accelerometerX":
-      case "accelerometerY":
-      case "accelerometerZ":
-      case "gesture": {
-        this.accelerometer.setValue(id, value);
-        break;
-      }
-      case "compassX":
-      case "compassY":
-      case "compassZ":
-      case "compassHeading": {
-        this.compass.setValue(id, value);
-        break;
-      }
-      case "buttonA": {
-        this.buttons[0].setValue(value);
-        break;
-      }
-      case "buttonB": {
-        this.buttons[1].setValue(value);
-        break;
-      }
-      case "pinLogo": {
-        this.pins[MICROBIT_HAL_PIN_FACE].setValue(value);
-        break;
-      }
-      case "pin0": {
-        this.pins[MICROBIT_HAL_PIN_P0].setValue(value);
-        break;
-      }
-      case "pin1": {
-        this.pins[MICROBIT_HAL_PIN_P1].setValue(value);
-        break;
-      }
-      case "pin2": {
-        this.pins[MICROBIT_HAL_PIN_P2].setValue(value);
-        break;
-      }
-      case "lightLevel": {
-        this.display.lightLevel.setValue(value);
-        break;
-      }
-      case "soundLevel": {
-        this.microphone.setValue(value);
-        break;
-      }
-      case "temperature": {
-        this.temperature.setValue(value);
-        break;
-      }
+    this.recordInputs([{ kind: "set_value", id, value }]);
+    setSensorValue(
+      {
+        accelerometer: this.accelerometer,
+        compass: this.compass,
+        buttons: this.buttons,
+        pins: this.pins,
+        lightLevel: this.display.lightLevel,
+        microphone: this.microphone,
+        temperature: this.temperature,
+      },
+      id,
+      value
+    );
+    this.syncSensorRegisters();
+  }
+
+  /**
+   * Copy the sensor values into Wasm memory where the HAL reads them.
+   *
+   * Called whenever a value might have changed.
+   */
+  private syncSensorRegisters() {
+    if (!this.module) {
+      return;
+    }
+    writeSensorRegisters(this.module.sensorRegisters, this.getState());
+    if (this.module instanceof WorkerModule) {
+      this.module.addButtonPresses(this.buttons);
     }
   }
 
+  /**
+   * Milliseconds since the program started, from a monotonic clock.
+   */
   ticksMilliseconds() {
-    return new Date().getTime() - this.epoch!;
+    return Math.floor(this.ticksMicroseconds() / 1000);
+  }
+
+  /**
+   * Microseconds since the program started, from a monotonic clock.
+   */
+  ticksMicroseconds() {
+    return Math.floor((performance.now() - this.epoch!) * 1000);
   }
 
   private initializePlayButton() {
@@ -412,10 +526,13 @@ export class Board {
     this.modulePromise = this.createModule();
     const module = await this.modulePromise;
     this.module = module;
+    this.syncSensorRegisters();
     let panicCode: number | undefined;
+    let stoppedCleanly = false;
     try {
       this.displayRunningState();
-      await module.start();
+      await module.start(this.heapSize);
+      stoppedCleanly = true;
     } catch (e: any) {
       // Take care not to overwrite another kind of stop just because the program
       // called restart or panic.
@@ -432,11 +549,20 @@ export class Board {
         this.notifications.onInternalError(e);
       }
     }
-    try {
-      module.forceStop();
-    } catch (e: any) {
-      if (e.name !== "ExitStatus") {
-        this.notifications.onInternalError(e);
+    if (module instanceof ModuleWrapper) {
+      this.notifications.onGcStats(module.gcStats());
+    }
+    if (stoppedCleanly && module instanceof ModuleWrapper) {
+      // MicroPython has deinitialized so we can run it again.
+      this.idleModule = module;
+    } else {
+      // After an exception the Wasm stack and Asyncify state are unknown.
+      try {
+        module.forceStop();
+      } catch (e: any) {
+        if (e.name !== "ExitStatus") {
+          this.notifications.onInternalError(e);
+        }
       }
     }
     // Called by the HAL for normal shutdown but not in error scenarios.
@@ -532,7 +658,12 @@ export class Board {
     };
     // Ensure it's stopped before flash.
     await this.stop(true);
-    flashFileSystem();
+    if (this.worker) {
+      // The worker owns the file system.
+      this.worker.flash(filesystem);
+    } else {
+      flashFileSystem();
+    }
     return this.start();
   }
 
@@ -655,35 +786,93 @@ export class Board {
   }
 
   writeSerialInput(text: string) {
-    for (let i = 0; i < text.length; i++) {
-      this.serialInputBuffer.push(text.charCodeAt(i));
+    if (this.worker) {
+      this.worker.writeSerialInput(text);
+      return;
     }
+    this.recordInputs([{ kind: "serial_input", data: text }]);
+    this.serialInputBuffer.writeText(text);
+  }
+
+  randomWord(): number {
+    const word = randomWord();
+    this.recordInputs([{ kind: "random", word }]);
+    return word;
+  }
+
+  private recordInputs(inputs: TraceInput[]) {
+    inputs.forEach((input) => this.recorder?.record(input));
+  }
+
+  /**
+   * Called before the HAL sleeps for ms, yielding to the event loop.
+   *
+   * @returns true to really sleep.
+   */
+  sleep(ms: number): boolean {
+    this.recorder?.yielded();
+    return true;
+  }
+
+  /**
+   * Called each time the HAL checks whether to yield between events.
+   *
+   * @param due Whether the HAL has used up its time slice.
+   * @returns true to yield.
+   */
+  shouldYield(due: boolean): boolean {
+    this.recorder?.polled(due);
+    return due;
   }
 
   /**
-   * Read a character code from the serial input buffer or -1 if none.
+   * Read serial input into target, see SerialInputBuffer.read.
    */
-  readSerialInput(): number {
-    return this.serialInputBuffer.shift() ?? -1;
+  readSerialInput(target: Uint8Array, interruptChar: number): number {
+    return this.serialInputBuffer.read(target, interruptChar);
   }
 
-  writeSerialOutput(text: string): void {
+  /**
+   * @returns true if the HAL should back off as output is backing up.
+   */
+  writeSerialOutput(text: string): boolean {
     // Avoid the Ctrl-C, Ctrl-D output when we request a stop.
-    if (this.modulePromise) {
-      this.notifications.onSerialOutput(text);
+    const backoff = this.modulePromise ? this.serialOutput.write(text) : false;
+    this.recorder?.serialWritten(backoff);
+    return backoff;
+  }
+
+  receiveRadio(data: Uint8Array) {
+    if (this.worker) {
+      this.worker.receiveRadio(data);
+    } else {
+      this.recordInputs([{ kind: "radio_input", data }]);
+      this.radio.receive(data);
     }
   }
 
-  writeRadioRxBuffer(packet: Uint8Array): number {
-    if (!this.module) {
-      throw new Error("Must be running as called via HAL");
+  programFinished() {
+    // The REPL runs next, as on a device.
+  }
+
+  gcCollected() {
+    const now = performance.now();
+    if (
+      this.module instanceof ModuleWrapper &&
+      now - this.lastGcStatsMs >= gcStatsIntervalMs
+    ) {
+      this.lastGcStatsMs = now;
+      this.notifications.onGcStats(this.module.gcStats());
     }
-    return this.module.writeRadioRxBuffer(packet);
   }
 
   initialize() {
-    this.epoch = new Date().getTime();
-    this.serialInputBuffer.length = 0;
+    this.epoch = performance.now();
+    this.serialInputBuffer.clear();
+    if (this.recordTrace) {
+      this.recorder = new TraceRecorder(() => this.ticksMicroseconds());
+      this.recordInputs(stateInputs(this.getState()));
+    }
   }
 
   stopComponents() {
@@ -696,7 +885,15 @@ export class Board {
     this.microphone.boardStopped();
     this.radio.boardStopped();
     this.dataLogging.boardStopped();
-    this.serialInputBuffer.length = 0;
+    this.serialInputBuffer.clear();
+    this.serialOutput.flush();
+    if (this.recorder) {
+      this.notifications.onTrace(
+        this.recorder.toBytes(),
+        this.recorder.truncated
+      );
+      this.recorder = undefined;
+    }
 
     // Nofify of the state resets.
     this.notifications.onStateChange(this.getState());
@@ -735,7 +932,8 @@ export class Notifications {
   };
 
   onRadioOutput = (data: Uint8Array) => {
-    this.postMessage("radio_output", { data });
+    // Copy as data is a view of module memory.
+    this.postMessage("radio_output", { data: data.slice() });
   };
 
   onLogOutput = (data: LogEntry) => {
@@ -746,6 +944,14 @@ export class Notifications {
     this.postMessage("log_delete", {});
   };
 
+  onGcStats = (stats: GcStats) => {
+    this.postMessage("gc_stats", { stats });
+  };
+
+  onTrace = (data: Uint8Array, truncated: boolean) => {
+    this.postMessage("trace", { data, truncated });
+  };
+
   onInternalError = (error: any) => {
     this.postMessage("internal_error", { error });
   };
@@ -766,8 +972,23 @@ export const createMessageListener = (board: Board) => (e: MessageEvent) => {
     const { data } = e;
     switch (data.kind) {
       case "config": {
-        const { language, translations } = data;
+        const {
+          language,
+          translations,
+          serialOutputLatencyMs,
+          recordTrace,
+          heapSize,
+        } = data;
         board.updateTranslations(language, translations);
+        if (typeof serialOutputLatencyMs === "number") {
+          board.serialOutput.maxLatencyMs = serialOutputLatencyMs;
+        }
+        if (typeof recordTrace === "boolean") {
+          board.recordTrace = recordTrace;
+        }
+        if (typeof heapSize === "number") {
+          board.heapSize = validHeapSize(heapSize);
+        }
         break;
       }
       case "flash": {
@@ -805,7 +1026,7 @@ export const createMessageListener = (board: Board) => (e: MessageEvent) => {
         if (!(data.data instanceof Uint8Array)) {
           throw new Error("Invalid radio_input data field.");
         }
-        board.radio.receive(data.data);
+        board.receiveRadio(data.data);
         break;
       }
       case "set_value": {
@@ -831,26 +1052,34 @@ function isFileSystem(
   );
 }
 
-const fetchWasm = async () => {
-  const response = await fetch("./build/firmware.wasm");
-  if (!response.ok) {
-    throw new Error(response.statusText);
-  }
-  return response.arrayBuffer();
-};
-
-const compileWasm = async () => {
-  // Can't use streaming in Safari 14 but would be nice to feature detect.
-  return WebAssembly.compile(new Uint8Array(await fetchWasm()));
+let compiledWasmPromise: Promise<CompiledWasm>;
+
+/**
+ * Load the Emscripten JavaScript, defining window.createModule, and start
+ * compiling the Wasm.
+ */
+const loadFirmware = (
+  firmware: Firmware,
+  wasmCacheVersion: string | undefined
+): Promise<void> => {
+  compiledWasmPromise = compileWasm(
+    `./build/${firmware}.wasm`,
+    wasmCacheVersion
+  );
+  return new Promise((resolve, reject) => {
+    const script = document.createElement("script");
+    script.src = `build/${firmware}.js`;
+    script.onload = () => resolve();
+    script.onerror = () => reject(new Error(`Failed to load ${script.src}`));
+    document.body.appendChild(script);
+  });
 };
 
-let compiledWasmPromise: Promise<WebAssembly.Module> = compileWasm();
-
 const instantiateWasm = function (imports: any, successCallback: any) {
   // No easy way to communicate failure here so hard to add retries.
   compiledWasmPromise
-    .then(async (wasmModule) => {
-      const instance = await WebAssembly.instantiate(wasmModule, imports);
+    .then(async ({ module }) => {
+      const instance = await WebAssembly.instantiate(module, imports);
       successCallback(instance);
     })
     .catch((e) => {
@@ -6,8 +6,8 @@ import { RangeSensor, State } from "./state";
 
 type SoundLevelCallback = (v: number) => void;
 
-export class Microphone {
-  public soundLevel: RangeSensor = new RangeSensor(
+abstract class BaseMicrophone {
+  soundLevel: RangeSensor = new RangeSensor(
     "soundLevel",
     0,
     255,
@@ -18,18 +18,7 @@ export class Microphone {
   );
   private soundLevelCallback: SoundLevelCallback | undefined;
 
-  constructor(
-    private element: SVGElement,
-    private onChange: (changes: Partial<State>) => void
-  ) {}
-
-  microphoneOn() {
-    this.element.style.display = "unset";
-  }
-
-  private microphoneOff() {
-    this.element.style.display = "none";
-  }
+  microphoneOn() {}
 
   setThreshold(threshold: "low" | "high", value: number) {
     const proposed = value > 255 ? 255 : value < 0 ? 0 : value;
@@ -38,31 +27,56 @@ export class Microphone {
     } else {
       this.soundLevel.highThreshold = proposed;
     }
-    this.onChange({
-      soundLevel: this.soundLevel,
-    });
   }
 
   setValue(value: number) {
     const prev = this.soundLevel.value;
-    const curr = value;
-    this.soundLevel.value = value;
+    this.soundLevel.setValue(value);
+    const curr = this.soundLevel.value;
 
     const low = this.soundLevel.lowThreshold!;
     const high = this.soundLevel.highThreshold!;
     if (this.soundLevelCallback) {
       if (prev > low && curr <= low) {
         this.soundLevelCallback(MICROBIT_HAL_MICROPHONE_EVT_THRESHOLD_LOW);
-      } else if (prev < high && curr >= high!) {
+      } else if (prev < high && curr >= high) {
         this.soundLevelCallback(MICROBIT_HAL_MICROPHONE_EVT_THRESHOLD_HIGH);
       }
     }
   }
 
-  initializeCallbacks(soundLevelCallback: (v: number) => void) {
+  initializeCallbacks(soundLevelCallback: SoundLevelCallback) {
     this.soundLevelCallback = soundLevelCallback;
   }
 
+  boardStopped() {}
+}
+
+export class StubMicrophone extends BaseMicrophone {}
+
+export class Microphone extends BaseMicrophone {
+  constructor(
+    private element: SVGElement,
+    private onChange: (changes: Partial<State>) => void
+  ) {
+    super();
+  }
+
+  microphoneOn() {
+    this.element.style.display = "unset";
+  }
+
+  private microphoneOff() {
+    this.element.style.display = "none";
+  }
+
+  setThreshold(threshold: "low" | "high", value: number) {
+    super.setThreshold(threshold, value);
+    this.onChange({
+      soundLevel: this.soundLevel,
+    });
+  }
+
   boardStopped() {
     this.microphoneOff();
   }
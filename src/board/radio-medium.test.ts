@@ -0,0 +1,118 @@
+import { describe, expect, it, vi } from "vitest";
+import { VirtualClock } from "./clock";
+import { Radio } from "./radio";
+import { RadioMedium } from "./radio-medium";
+
+const maxPayload = 32;
+const queue = 3;
+
+const createRadio = (group: number) => {
+  const radio = new Radio(
+    () => {},
+    vi.fn(),
+    () => 0
+  );
+  const ring = new Uint8Array(2 + queue * (maxPayload + 6));
+  radio.enable({ maxPayload, queue, group }, ring);
+  // The number of packets queued and the RSSI byte of the first.
+  const received = () => ring[1];
+  const rssi = () => ring[2 + 1 + ring[2]];
+  return { radio, received, rssi };
+};
+
+describe("RadioMedium", () => {
+  const msg = new TextEncoder().encode("hello");
+
+  it("delivers to other radios in the same group", () => {
+    const medium = new RadioMedium({ rssi: -40 });
+    const a = createRadio(1);
+    const b = createRadio(1);
+    const c = createRadio(2);
+    [a, b, c].forEach(({ radio }) => medium.attach(radio));
+
+    a.radio.send(msg);
+
+    expect(a.received()).toEqual(0);
+    expect(b.received()).toEqual(1);
+    expect(b.rssi()).toEqual(40);
+    expect(c.received()).toEqual(0);
+    expect(medium.stats).toEqual({
+      sent: 1,
+      delivered: 1,
+      lost: 0,
+      dropped: 0,
+    });
+  });
+
+  it("delays packets by the latency", () => {
+    const clock = new VirtualClock();
+    const medium = new RadioMedium({ latencyMs: 10 }, clock);
+    const a = createRadio(1);
+    const b = createRadio(1);
+    medium.attach(a.radio);
+    medium.attach(b.radio);
+
+    a.radio.send(msg);
+    clock.advance(9);
+    expect(b.received()).toEqual(0);
+    clock.advance(1);
+    expect(b.received()).toEqual(1);
+  });
+
+  it("misses packets that arrive after a group change or detach", () => {
+    const clock = new VirtualClock();
+    const medium = new RadioMedium({ latencyMs: 10 }, clock);
+    const a = createRadio(1);
+    const b = createRadio(1);
+    const c = createRadio(1);
+    medium.attach(a.radio);
+    medium.attach(b.radio);
+    const detachC = medium.attach(c.radio);
+
+    a.radio.send(msg);
+    b.radio.updateConfig({ maxPayload, queue, group: 2 });
+    detachC();
+    clock.advance(10);
+    expect(b.received()).toEqual(0);
+    expect(c.received()).toEqual(0);
+    expect(c.radio.medium).toBeUndefined();
+  });
+
+  it("loses packets at the given rate", () => {
+    const random = vi.fn().mockReturnValueOnce(0.1).mockReturnValueOnce(0.9);
+    const medium = new RadioMedium({ loss: 0.5 }, undefined, random);
+    const a = createRadio(1);
+    const b = createRadio(1);
+    medium.attach(a.radio);
+    medium.attach(b.radio);
+
+    a.radio.send(msg);
+    a.radio.send(msg);
+    expect(b.received()).toEqual(1);
+    expect(medium.stats).toEqual({
+      sent: 2,
+      delivered: 1,
+      lost: 1,
+      dropped: 0,
+    });
+  });
+
+  it("counts packets dropped by a full queue", () => {
+    const medium = new RadioMedium();
+    const a = createRadio(1);
+    const b = createRadio(1);
+    medium.attach(a.radio);
+    medium.attach(b.radio);
+
+    for (let i = 0; i < queue + 1; i++) {
+      a.radio.send(msg);
+    }
+    expect(b.received()).toEqual(queue);
+    expect(medium.stats).toEqual({
+      sent: queue + 1,
+      delivered: queue,
+      lost: 0,
+      dropped: 1,
+    });
+  });
+});
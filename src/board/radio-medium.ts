@@ -0,0 +1,128 @@
+import { Clock, RealClock } from "./clock";
+import { Radio } from "./radio";
+
+export interface RadioMediumOptions {
+  /**
+   * Delay before a packet arrives. Defaults to 0.
+   */
+  latencyMs?: number;
+  /**
+   * Extra random delay up to this, so packets can arrive out of order.
+   * Defaults to 0.
+   */
+  jitterMs?: number;
+  /**
+   * Chance in [0, 1] that a receiver misses a packet. Defaults to 0.
+   */
+  loss?: number;
+  /**
+   * Signal strength in dBm seen by receivers, fixed or by sender and
+   * receiver. Defaults to -127, as for packets from the parent window.
+   */
+  rssi?: number | ((sender: Radio, receiver: Radio) => number);
+}
+
+export interface RadioMediumStats {
+  sent: number;
+  delivered: number;
+  /**
+   * Missed by a receiver due to the loss rate.
+   */
+  lost: number;
+  /**
+   * Arrived while the receiver's queue was full.
+   */
+  dropped: number;
+}
+
+/**
+ * Routes packets between the radios of boards in the same process.
+ *
+ * A packet sent by one radio is received by every other attached radio that
+ * is enabled in the same group when it arrives.
+ */
+export class RadioMedium {
+  stats: RadioMediumStats = { sent: 0, delivered: 0, lost: 0, dropped: 0 };
+  private radios: Radio[] = [];
+  private pending = new Set<() => void>();
+
+  constructor(
+    private options: RadioMediumOptions = {},
+    private clock: Clock = new RealClock(),
+    private random: () => number = Math.random
+  ) {}
+
+  /**
+   * @returns A function that detaches the radio.
+   */
+  attach(radio: Radio): () => void {
+    this.radios.push(radio);
+    radio.medium = this;
+    return () => {
+      this.radios = this.radios.filter((r) => r !== radio);
+      radio.medium = undefined;
+    };
+  }
+
+  transmit(sender: Radio, data: Uint8Array): void {
+    this.stats.sent++;
+    const { group } = sender.state;
+    const { latencyMs = 0, jitterMs = 0, loss = 0 } = this.options;
+    for (const receiver of this.radios) {
+      if (receiver === sender) {
+        continue;
+      }
+      if (loss > 0 && this.random() < loss) {
+        this.stats.lost++;
+        continue;
+      }
+      const delayMs = latencyMs + (jitterMs > 0 ? jitterMs * this.random() : 0);
+      if (delayMs <= 0) {
+        this.deliver(sender, receiver, group, data);
+      } else {
+        // data is only valid during the call.
+        const copy = data.slice();
+        const cancel = this.clock.schedule(() => {
+          this.pending.delete(cancel);
+          this.deliver(sender, receiver, group, copy);
+        }, delayMs);
+        this.pending.add(cancel);
+      }
+    }
+  }
+
+  /**
+   * Drop packets still in flight.
+   */
+  dispose(): void {
+    this.pending.forEach((cancel) => cancel());
+    this.pending.clear();
+  }
+
+  private deliver(
+    sender: Radio,
+    receiver: Radio,
+    group: number,
+    data: Uint8Array
+  ) {
+    // As for a real radio, a receiver that's disabled or listening on
+    // another group misses it.
+    if (
+      !this.radios.includes(receiver) ||
+      !receiver.state.enabled ||
+      receiver.state.group !== group
+    ) {
+      return;
+    }
+    const { rssi = -127 } = this.options;
+    const queued = receiver.receive(
+      data,
+      typeof rssi === "function" ? rssi(sender, receiver) : rssi
+    );
+    if (queued) {
+      this.stats.delivered++;
+    } else {
+      this.stats.dropped++;
+    }
+  }
+}
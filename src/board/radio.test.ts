@@ -10,6 +10,21 @@ const longMsg = encoder.encode(
 // Truncated to 32 bytes - 3 bytes for header info.
 const longMsgTruncated = encoder.encode("This is a message that is lon");
 
+// Peek and pop as drv_radio.c does.
+const ringSize = (maxPayload: number, queue: number) =>
+  2 + queue * (maxPayload + 6);
+const peek = (ring: Uint8Array, maxPayload: number) => {
+  if (ring[1] === 0) {
+    return undefined;
+  }
+  const offset = 2 + ring[0] * (maxPayload + 6);
+  return ring.subarray(offset, offset + 1 + ring[offset] + 5);
+};
+const pop = (ring: Uint8Array, queue: number) => {
+  ring[0] = (ring[0] + 1) % queue;
+  ring[1]--;
+};
+
 describe("Radio", () => {
   let time = 0;
   let sentMessages: Uint8Array[] = [];
@@ -17,20 +32,25 @@ describe("Radio", () => {
   const onSend = (data: Uint8Array) => sentMessages.push(data);
   let onChange = vi.fn();
   let radio = new Radio(onSend, onChange, currentTime);
+  let ring = new Uint8Array(ringSize(32, 3));
 
   afterEach(() => {
     time = 0;
     sentMessages = [];
     onChange = vi.fn();
     radio = new Radio(onSend, onChange, currentTime);
+    ring = new Uint8Array(ringSize(32, 3));
   });
 
   beforeEach(() => {
-    radio.enable({
-      maxPayload: 32,
-      queue: 3,
-      group: 1,
-    });
+    radio.enable(
+      {
+        maxPayload: 32,
+        queue: 3,
+        group: 1,
+      },
+      ring
+    );
   });
 
   it("sends messages", () => {
@@ -41,9 +61,9 @@ describe("Radio", () => {
 
   it("handles receiving user messages", () => {
     radio.receive(msg);
-    expect(radio.peek()!.join("")).toContain(msg.join(""));
-    radio.pop();
-    expect(radio.peek()).toBeUndefined();
+    expect(peek(ring, 32)!.join("")).toContain(msg.join(""));
+    pop(ring, 3);
+    expect(peek(ring, 32)).toBeUndefined();
   });
 
   it("enables the radio with the correct config", () => {
@@ -65,8 +85,8 @@ describe("Radio", () => {
 
   it("receives a message that is too big and truncates it appropriately", () => {
     radio.receive(longMsg);
-    expect(radio.peek()!.join("")).not.toContain(longMsg.join(""));
-    expect(radio.peek()!.join("")).toContain(longMsgTruncated.join(""));
+    expect(peek(ring, 32)!.join("")).not.toContain(longMsg.join(""));
+    expect(peek(ring, 32)!.join("")).toContain(longMsgTruncated.join(""));
   });
 
   it("handles the message queue correctly", () => {
@@ -75,14 +95,33 @@ describe("Radio", () => {
     radio.receive(altMsg);
     // No more messages can be received based on the queue length set in config.
     radio.receive(msg);
-    expect(radio.peek()!.join("")).toContain(msg.join(""));
-    radio.pop();
-    expect(radio.peek()!.join("")).toContain(msg.join(""));
-    radio.pop();
-    expect(radio.peek()!.join("")).toContain(altMsg.join(""));
-    radio.pop();
+    expect(peek(ring, 32)!.join("")).toContain(msg.join(""));
+    pop(ring, 3);
+    expect(peek(ring, 32)!.join("")).toContain(msg.join(""));
+    pop(ring, 3);
+    expect(peek(ring, 32)!.join("")).toContain(altMsg.join(""));
+    pop(ring, 3);
     // Confirm that fourth message was not added to the queue.
-    expect(radio.peek()).toBeUndefined();
+    expect(peek(ring, 32)).toBeUndefined();
+  });
+
+  it("reuses slots as packets are popped", () => {
+    time = 0x01020304;
+    radio.receive(msg);
+    radio.receive(msg);
+    pop(ring, 3);
+    pop(ring, 3);
+    radio.receive(altMsg);
+    radio.receive(altMsg);
+    expect(ring[0]).toEqual(2);
+    const packet = peek(ring, 32)!;
+    expect(packet[0]).toEqual(altMsg.length);
+    expect(packet.subarray(1, 1 + altMsg.length)).toEqual(altMsg);
+    expect(Array.from(packet.subarray(1 + altMsg.length))).toEqual([
+      127, 6, 3, 2, 1,
+    ]);
+    pop(ring, 3);
+    expect(peek(ring, 32)!.subarray(1, 1 + altMsg.length)).toEqual(altMsg);
   });
 
   it("updates the config group without clearing receive queue", () => {
@@ -99,11 +138,11 @@ describe("Radio", () => {
       enabled: true,
       group: 2,
     });
-    expect(radio.peek()!.join("")).toContain(msg.join(""));
-    radio.pop();
-    expect(radio.peek()!.join("")).toContain(msg.join(""));
-    radio.pop();
-    expect(radio.peek()!.join("")).toContain(altMsg.join(""));
+    expect(peek(ring, 32)!.join("")).toContain(msg.join(""));
+    pop(ring, 3);
+    expect(peek(ring, 32)!.join("")).toContain(msg.join(""));
+    pop(ring, 3);
+    expect(peek(ring, 32)!.join("")).toContain(altMsg.join(""));
   });
 
   it("throws an error if maxPayload or queue are updated without disabling the radio first", () => {
@@ -120,13 +159,17 @@ describe("Radio", () => {
 
   it("updates all config fields successfully", () => {
     radio.disable();
-    radio.enable({
-      maxPayload: 64,
-      queue: 6,
-      group: 2,
-    });
+    ring = new Uint8Array(ringSize(64, 6));
+    radio.enable(
+      {
+        maxPayload: 64,
+        queue: 6,
+        group: 2,
+      },
+      ring
+    );
     radio.receive(longMsg);
     // Long message over 32 bytes, but under 64 bytes can now be received in its entirety.
-    expect(radio.peek()!.join("")).toContain(longMsg.join(""));
+    expect(peek(ring, 64)!.join("")).toContain(longMsg.join(""));
   });
 });
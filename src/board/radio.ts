@@ -1,3 +1,4 @@
+import { RadioMedium } from "./radio-medium";
 import { RadioState, State } from "./state";
 
 export interface RadioConfig {
@@ -6,57 +7,71 @@ export interface RadioConfig {
   group: number;
 }
 
+// The receive ring's layout, see drv_radio.c.
+const ringHead = 0;
+const ringCount = 1;
+const ringSlots = 2;
+const packetOverhead =
+  1 + // len
+  1 + // RSSI
+  4; // time
+
 export class Radio {
-  private rxQueue: Uint8Array[] | undefined;
+  /**
+   * The receive queue, in module memory so the HAL peeks and pops packets
+   * without calling out.
+   */
+  private rxRing: Uint8Array | undefined;
   private config: RadioConfig | undefined;
+  /**
+   * Set while attached to a medium shared with other boards.
+   */
+  medium: RadioMedium | undefined;
   state: RadioState = { type: "radio", enabled: false, group: 0 };
 
   constructor(
+    /**
+     * Called with a view of module memory that's only valid during the call.
+     */
     private onSend: (data: Uint8Array) => void,
     private onChange: (changes: Partial<State>) => void,
     private ticksMilliseconds: () => number
   ) {}
 
-  peek(): Uint8Array | undefined {
-    return this.rxQueue![0];
-  }
-
-  pop() {
-    this.rxQueue!.shift();
-  }
-
   send(data: Uint8Array) {
     this.onSend(data);
+    this.medium?.transmit(this, data);
   }
 
-  receive(data: Uint8Array) {
-    if (this.rxQueue!.length === this.config!.queue) {
+  /**
+   * @param rssi Signal strength in dBm.
+   * @returns false if the queue was full so the packet was dropped.
+   */
+  receive(data: Uint8Array, rssi: number = -127): boolean {
+    const ring = this.rxRing!;
+    const { queue, maxPayload } = this.config!;
+    const count = ring[ringCount];
+    if (count === queue) {
       // Drop the message as the queue is full.
-    } else {
-      // Truncate at the payload size as we're writing to a fixed size buffer.
-      const len = Math.min(data.length, this.config!.maxPayload);
-      data = data.slice(0, len);
-      // Add extra information to make a radio packet in the expected format
-      // rather than just data. Clients must prepend \x01\x00\x01 if desired.
-      const size =
-        1 + // len
-        len +
-        1 + // RSSI
-        4; // time
-      const rssi = 127; // This is inverted by modradio.
-      const time = this.ticksMilliseconds();
-
-      const packet = new Uint8Array(size);
-      packet[0] = len;
-      packet.set(data, 1);
-      packet[1 + len] = rssi;
-      packet[1 + len + 1] = time & 0xff;
-      packet[1 + len + 2] = (time >> 8) & 0xff;
-      packet[1 + len + 3] = (time >> 16) & 0xff;
-      packet[1 + len + 4] = (time >> 24) & 0xff;
-
-      this.rxQueue!.push(packet);
+      return false;
     }
+    // Truncate at the payload size as we're writing to a fixed size slot.
+    const len = Math.min(data.length, maxPayload);
+    const slot = (ring[ringHead] + count) % queue;
+    const offset = ringSlots + slot * (maxPayload + packetOverhead);
+    // Add extra information to make a radio packet in the expected format
+    // rather than just data. Clients must prepend \x01\x00\x01 if desired.
+    const time = this.ticksMilliseconds();
+    ring[offset] = len;
+    ring.set(data.subarray(0, len), offset + 1);
+    // Stored positive as modradio inverts it.
+    ring[offset + 1 + len] = Math.min(255, Math.max(0, -Math.round(rssi)));
+    ring[offset + 1 + len + 1] = time & 0xff;
+    ring[offset + 1 + len + 2] = (time >> 8) & 0xff;
+    ring[offset + 1 + len + 3] = (time >> 16) & 0xff;
+    ring[offset + 1 + len + 4] = (time >> 24) & 0xff;
+    ring[ringCount] = count + 1;
+    return true;
   }
 
   updateConfig(config: RadioConfig) {
@@ -81,9 +96,9 @@ export class Radio {
     }
   }
 
-  enable(config: RadioConfig) {
+  enable(config: RadioConfig, rxRing: Uint8Array) {
     this.config = config;
-    this.rxQueue = [];
+    this.rxRing = rxRing;
     if (!this.state.enabled) {
       this.state = {
         ...this.state,
@@ -97,7 +112,7 @@ export class Radio {
   }
 
   disable() {
-    this.rxQueue = undefined;
+    this.rxRing = undefined;
 
     if (this.state.enabled) {
       this.state.enabled = false;
@@ -108,7 +123,7 @@ export class Radio {
   }
 
   boardStopped() {
-    this.rxQueue = undefined;
+    this.rxRing = undefined;
     this.config = undefined;
     this.state = {
       type: "radio",
@@ -0,0 +1,61 @@
+import { describe, expect, it } from "vitest";
+import { RingBuffer } from "./ring";
+
+const bytes = (...values: number[]) => new Uint8Array(values);
+
+describe("RingBuffer", () => {
+  it("reads back what was written", () => {
+    const ring = RingBuffer.create(8);
+    expect(ring.write(bytes(1, 2, 3))).toEqual(3);
+    expect(ring.available()).toEqual(3);
+    const target = new Uint8Array(8);
+    expect(ring.read(target)).toEqual(3);
+    expect(target.subarray(0, 3)).toEqual(bytes(1, 2, 3));
+    expect(ring.available()).toEqual(0);
+  });
+
+  it("wraps around the end of the buffer", () => {
+    const ring = RingBuffer.create(8);
+    const target = new Uint8Array(8);
+    ring.write(bytes(1, 2, 3, 4, 5, 6));
+    ring.read(target.subarray(0, 5));
+    expect(ring.write(bytes(7, 8, 9, 10, 11))).toEqual(5);
+    expect(ring.read(target)).toEqual(6);
+    expect(target.subarray(0, 6)).toEqual(bytes(6, 7, 8, 9, 10, 11));
+  });
+
+  it("writes only what fits", () => {
+    const ring = RingBuffer.create(4);
+    expect(ring.write(bytes(1, 2, 3, 4, 5, 6))).toEqual(4);
+    expect(ring.space()).toEqual(0);
+    expect(ring.write(bytes(7))).toEqual(0);
+  });
+
+  it("writes whole messages or nothing", () => {
+    const ring = RingBuffer.create(8);
+    expect(ring.writeMessage(bytes(1, 2, 3))).toEqual(true);
+    expect(ring.writeMessage(bytes(4, 5, 6))).toEqual(false);
+    expect(ring.writeMessage(bytes(4))).toEqual(true);
+    expect(ring.readMessage()).toEqual(bytes(1, 2, 3));
+    expect(ring.readMessage()).toEqual(bytes(4));
+    expect(ring.readMessage()).toBeUndefined();
+  });
+
+  it("waits for a complete message", () => {
+    const ring = RingBuffer.create(16);
+    ring.write(bytes(3, 0, 1));
+    expect(ring.readMessage()).toBeUndefined();
+    ring.write(bytes(2, 3));
+    expect(ring.readMessage()).toEqual(bytes(1, 2, 3));
+  });
+
+  it("shares state via the buffer", () => {
+    const producer = RingBuffer.create(16);
+    const consumer = new RingBuffer(producer.buffer);
+    producer.writeMessage(bytes(42));
+    expect(consumer.readMessage()).toEqual(bytes(42));
+    producer.write(bytes(1, 2));
+    consumer.discard();
+    expect(producer.available()).toEqual(0);
+  });
+});
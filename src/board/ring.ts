@@ -0,0 +1,132 @@
+const READ = 0;
+const WRITE = 1;
+const headerSize = 8;
+
+/**
+ * A queue of bytes in a SharedArrayBuffer with one producer and one consumer,
+ * typically on different threads.
+ *
+ * No locking is needed as the producer only advances the write index and the
+ * consumer only advances the read index. One byte is left unused so that a
+ * full buffer can be distinguished from an empty one.
+ */
+export class RingBuffer {
+  private indexes: Int32Array;
+  private data: Uint8Array;
+
+  constructor(public readonly buffer: SharedArrayBuffer) {
+    this.indexes = new Int32Array(buffer, 0, 2);
+    this.data = new Uint8Array(buffer, headerSize);
+  }
+
+  static create(capacity: number): RingBuffer {
+    return new RingBuffer(new SharedArrayBuffer(headerSize + capacity + 1));
+  }
+
+  /**
+   * The number of bytes that can be read.
+   */
+  available(): number {
+    const size = this.data.length;
+    const read = Atomics.load(this.indexes, READ);
+    const write = Atomics.load(this.indexes, WRITE);
+    return (write - read + size) % size;
+  }
+
+  /**
+   * The number of bytes that can be written.
+   */
+  space(): number {
+    return this.data.length - 1 - this.available();
+  }
+
+  /**
+   * Producer only. Writes as much of source as fits.
+   *
+   * @returns the number of bytes written.
+   */
+  write(source: Uint8Array): number {
+    const length = Math.min(source.length, this.space());
+    const write = Atomics.load(this.indexes, WRITE);
+    const first = Math.min(length, this.data.length - write);
+    this.data.set(source.subarray(0, first), write);
+    this.data.set(source.subarray(first, length), 0);
+    Atomics.store(this.indexes, WRITE, (write + length) % this.data.length);
+    return length;
+  }
+
+  /**
+   * Consumer only. Reads up to target.length bytes.
+   *
+   * @returns the number of bytes read.
+   */
+  read(target: Uint8Array): number {
+    const length = Math.min(target.length, this.available());
+    const read = Atomics.load(this.indexes, READ);
+    const first = Math.min(length, this.data.length - read);
+    target.set(this.data.subarray(read, read + first));
+    target.set(this.data.subarray(0, length - first), first);
+    this.advanceRead((read + length) % this.data.length);
+    return length;
+  }
+
+  /**
+   * Producer only. Writes a length prefixed message, or nothing if there
+   * isn't room for all of it.
+   */
+  writeMessage(message: Uint8Array): boolean {
+    if (message.length > 0xffff) {
+      throw new Error("Message too large");
+    }
+    if (this.space() < message.length + 2) {
+      return false;
+    }
+    this.write(new Uint8Array([message.length & 0xff, message.length >> 8]));
+    this.write(message);
+    return true;
+  }
+
+  /**
+   * Consumer only. Reads a message written by writeMessage.
+   *
+   * @returns the message or undefined if there isn't a complete one yet.
+   */
+  readMessage(): Uint8Array | undefined {
+    const available = this.available();
+    if (available < 2) {
+      return undefined;
+    }
+    const read = Atomics.load(this.indexes, READ);
+    const length =
+      this.data[read] | (this.data[(read + 1) % this.data.length] << 8);
+    if (available < length + 2) {
+      return undefined;
+    }
+    this.advanceRead((read + 2) % this.data.length);
+    const message = new Uint8Array(length);
+    this.read(message);
+    return message;
+  }
+
+  /**
+   * Consumer only. Discards everything that's been written.
+   */
+  discard(): void {
+    this.advanceRead(Atomics.load(this.indexes, WRITE));
+  }
+
+  /**
+   * Producer only. Blocks until the consumer reads or the timeout expires.
+   *
+   * Atomics.wait isn't permitted on the main thread so this is for workers.
+   */
+  waitForRead(timeoutMs: number): void {
+    const read = Atomics.load(this.indexes, READ);
+    Atomics.wait(this.indexes, READ, read, timeoutMs);
+  }
+
+  private advanceRead(read: number) {
+    Atomics.store(this.indexes, READ, read);
+    Atomics.notify(this.indexes, READ);
+  }
+}
@@ -0,0 +1,74 @@
+import { beforeEach, describe, expect, it } from "vitest";
+import { SerialInputBuffer } from "./serial-input";
+
+const ctrlC = 3;
+
+describe("SerialInputBuffer", () => {
+  let input = new SerialInputBuffer();
+
+  beforeEach(() => {
+    input = new SerialInputBuffer();
+  });
+
+  const readAll = (chunkSize: number, interruptChar: number = -1) => {
+    const result: number[] = [];
+    const target = new Uint8Array(chunkSize);
+    for (
+      let length = input.read(target, interruptChar);
+      length > 0;
+      length = input.read(target, interruptChar)
+    ) {
+      result.push(...target.subarray(0, length));
+    }
+    return result;
+  };
+
+  it("reads across writes", () => {
+    input.writeText("ab");
+    input.write(new Uint8Array([99, 100, 101]));
+    expect(readAll(2)).toEqual([97, 98, 99, 100, 101]);
+    expect(input.read(new Uint8Array(2), -1)).toEqual(0);
+  });
+
+  it("encodes text as UTF-8", () => {
+    input.writeText("é");
+    expect(readAll(1)).toEqual([0xc3, 0xa9]);
+  });
+
+  it("reads input before an interrupt first", () => {
+    input.writeText("ab");
+    input.writeText("c\x03d");
+    input.writeText("e");
+    const target = new Uint8Array(10);
+    expect(input.read(target, ctrlC)).toEqual(3);
+    expect(Array.from(target.subarray(0, 3))).toEqual([97, 98, 99]);
+    expect(input.read(target, ctrlC)).toEqual(-1);
+    expect(readAll(10, ctrlC)).toEqual([100, 101]);
+  });
+
+  it("reads up to an interrupt across several reads", () => {
+    input.writeText("abc\x03d");
+    const target = new Uint8Array(2);
+    expect(input.read(target, ctrlC)).toEqual(2);
+    expect(input.read(target, ctrlC)).toEqual(1);
+    expect(input.read(target, ctrlC)).toEqual(-1);
+    expect(readAll(2, ctrlC)).toEqual([100]);
+  });
+
+  it("drops input before an interrupt when there's no space", () => {
+    input.writeText("ab\x03c");
+    expect(input.read(new Uint8Array(0), ctrlC)).toEqual(-1);
+    expect(readAll(10, ctrlC)).toEqual([99]);
+  });
+
+  it("ignores the interrupt character when disabled", () => {
+    input.writeText("a\x03");
+    expect(readAll(10)).toEqual([97, 3]);
+  });
+
+  it("clears", () => {
+    input.writeText("abc");
+    input.clear();
+    expect(readAll(10)).toEqual([]);
+  });
+});
@@ -0,0 +1,90 @@
+/**
+ * Serial input waiting for the HAL to read it.
+ *
+ * The HAL reads in bulk straight into its stdin ring buffer.
+ */
+export class SerialInputBuffer {
+  private chunks: Uint8Array[] = [];
+  // Read position in chunks[0].
+  private offset = 0;
+  private encoder = new TextEncoder();
+  // An interrupt character we know isn't in the pending input.
+  private checkedInterruptChar: number | undefined;
+
+  writeText(text: string): void {
+    this.write(this.encoder.encode(text));
+  }
+
+  write(data: Uint8Array): void {
+    if (data.length > 0) {
+      this.chunks.push(data);
+      this.checkedInterruptChar = undefined;
+    }
+  }
+
+  /**
+   * Read pending input into target.
+   *
+   * Input before the interrupt character is read first. Once the read
+   * reaches the interrupt character we consume it and return -1. If there's
+   * no space for the input before it then that input is dropped, as on the
+   * device when its buffer is full, so the interrupt isn't held up.
+   *
+   * @param target Where to copy the input.
+   * @param interruptChar The interrupt character or -1 if disabled.
+   * @returns The number of bytes read or -1 for an interrupt.
+   */
+  read(target: Uint8Array, interruptChar: number): number {
+    const before = this.lengthBeforeInterrupt(interruptChar);
+    if (before === 0 || (before > 0 && target.length === 0)) {
+      this.skip(before + 1);
+      return -1;
+    }
+    const limit =
+      before === -1 ? target.length : Math.min(before, target.length);
+    let read = 0;
+    while (read < limit && this.chunks.length > 0) {
+      const chunk = this.chunks[0];
+      const length = Math.min(limit - read, chunk.length - this.offset);
+      target.set(chunk.subarray(this.offset, this.offset + length), read);
+      read += length;
+      this.skip(length);
+    }
+    return read;
+  }
+
+  clear(): void {
+    this.chunks.length = 0;
+    this.offset = 0;
+    this.checkedInterruptChar = undefined;
+  }
+
+  private skip(length: number) {
+    this.offset += length;
+    while (this.chunks.length > 0 && this.offset >= this.chunks[0].length) {
+      this.offset -= this.chunks[0].length;
+      this.chunks.shift();
+    }
+  }
+
+  /**
+   * @returns The length of the input before the interrupt character, or -1
+   * if there's no interrupt character in the pending input.
+   */
+  private lengthBeforeInterrupt(interruptChar: number): number {
+    if (interruptChar < 0 || interruptChar === this.checkedInterruptChar) {
+      return -1;
+    }
+    let length = 0;
+    for (let i = 0; i < this.chunks.length; i++) {
+      const from = i === 0 ? this.offset : 0;
+      const index = this.chunks[i].indexOf(interruptChar, from);
+      if (index !== -1) {
+        return length + index - from;
+      }
+      length += this.chunks[i].length - from;
+    }
+    this.checkedInterruptChar = interruptChar;
+    return -1;
+  }
+}
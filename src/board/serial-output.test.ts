@@ -0,0 +1,51 @@
+import { afterEach, beforeEach, describe, expect, it, vi } from "vitest";
+import { SerialOutputBuffer } from "./serial-output";
+
+describe("SerialOutputBuffer", () => {
+  let output: string[] = [];
+  let buffer = new SerialOutputBuffer((text) => output.push(text), 10, 8);
+
+  beforeEach(() => {
+    vi.useFakeTimers();
+    output = [];
+    buffer = new SerialOutputBuffer((text) => output.push(text), 10, 8);
+  });
+
+  afterEach(() => {
+    vi.useRealTimers();
+  });
+
+  it("coalesces writes until the latency expires", () => {
+    buffer.write("a");
+    buffer.write("b");
+    vi.advanceTimersByTime(9);
+    expect(output).toEqual([]);
+    vi.advanceTimersByTime(1);
+    expect(output).toEqual(["ab"]);
+
+    buffer.write("c");
+    vi.advanceTimersByTime(10);
+    expect(output).toEqual(["ab", "c"]);
+  });
+
+  it("flushes on demand", () => {
+    buffer.write("a");
+    buffer.flush();
+    expect(output).toEqual(["a"]);
+    vi.advanceTimersByTime(10);
+    expect(output).toEqual(["a"]);
+  });
+
+  it("signals backpressure at the high water mark", () => {
+    expect(buffer.write("1234567")).toEqual(false);
+    expect(buffer.write("8")).toEqual(true);
+    buffer.flush();
+    expect(buffer.write("1")).toEqual(false);
+  });
+
+  it("writes through with no latency", () => {
+    buffer.maxLatencyMs = 0;
+    expect(buffer.write("a")).toEqual(false);
+    expect(output).toEqual(["a"]);
+  });
+});
@@ -0,0 +1,47 @@
+/**
+ * Coalesces serial output so we send one message per flush rather than one
+ * per write from MicroPython.
+ */
+export class SerialOutputBuffer {
+  private pending = "";
+  private timeout: ReturnType<typeof setTimeout> | undefined;
+
+  /**
+   * @param onOutput Called with the coalesced output.
+   * @param maxLatencyMs The longest we'll hold output before flushing.
+   * @param highWaterMark Pending output length that signals backpressure.
+   */
+  constructor(
+    private onOutput: (text: string) => void,
+    public maxLatencyMs: number = 16,
+    private highWaterMark: number = 65536
+  ) {}
+
+  /**
+   * Buffer text for the next flush.
+   *
+   * @returns true if the writer should back off as we're not flushing fast
+   * enough, e.g. because it's not yielding to the event loop.
+   */
+  write(text: string): boolean {
+    this.pending += text;
+    if (this.maxLatencyMs <= 0) {
+      this.flush();
+    } else if (this.timeout === undefined) {
+      this.timeout = setTimeout(() => this.flush(), this.maxLatencyMs);
+    }
+    return this.pending.length >= this.highWaterMark;
+  }
+
+  flush(): void {
+    if (this.timeout !== undefined) {
+      clearTimeout(this.timeout);
+      this.timeout = undefined;
+    }
+    if (this.pending) {
+      const text = this.pending;
+      this.pending = "";
+      this.onOutput(text);
+    }
+  }
+}
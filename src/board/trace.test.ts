@@ -0,0 +1,170 @@
+import { describe, expect, it } from "vitest";
+import { readTrace, TracePlayer, TraceRecorder } from "./trace";
+
+describe("TraceRecorder", () => {
+  it("round trips events", () => {
+    let timeUs = 0;
+    const recorder = new TraceRecorder(() => timeUs);
+    recorder.record({ kind: "set_value", id: "temperature", value: -5 });
+    recorder.record({ kind: "random", word: 0xdeadbeef });
+    recorder.yielded();
+    recorder.yielded();
+    timeUs = 1_234_567;
+    recorder.record({ kind: "set_value", id: "gesture", value: "shake" });
+    recorder.record({ kind: "set_value", id: "compassX", value: 0.5 });
+    recorder.yielded();
+    timeUs = 2_000_000;
+    recorder.record({ kind: "serial_input", data: "héllo" });
+    recorder.record({
+      kind: "radio_input",
+      data: new Uint8Array([1, 0, 1, 65]),
+    });
+
+    expect(readTrace(recorder.toBytes())).toEqual([
+      {
+        kind: "set_value",
+        id: "temperature",
+        value: -5,
+        yields: 0,
+        timeUs: 0,
+      },
+      { kind: "random", word: 0xdeadbeef, yields: 0, timeUs: 0 },
+      {
+        kind: "set_value",
+        id: "gesture",
+        value: "shake",
+        yields: 2,
+        timeUs: 1_234_567,
+      },
+      {
+        kind: "set_value",
+        id: "compassX",
+        value: 0.5,
+        yields: 2,
+        timeUs: 1_234_567,
+      },
+      { kind: "serial_input", data: "héllo", yields: 3, timeUs: 2_000_000 },
+      {
+        kind: "radio_input",
+        data: new Uint8Array([1, 0, 1, 65]),
+        yields: 3,
+        timeUs: 2_000_000,
+      },
+    ]);
+  });
+
+  it("grows as needed", () => {
+    const recorder = new TraceRecorder(() => 0);
+    const data = "x".repeat(5000);
+    recorder.record({ kind: "serial_input", data });
+    expect(readTrace(recorder.toBytes())).toEqual([
+      { kind: "serial_input", data, yields: 0, timeUs: 0 },
+    ]);
+  });
+
+  it("records yields and serial back offs", () => {
+    let timeUs = 0;
+    const recorder = new TraceRecorder(() => timeUs);
+    recorder.polled(false);
+    recorder.polled(false);
+    timeUs = 5000;
+    recorder.polled(true);
+    recorder.yielded();
+    recorder.serialWritten(false);
+    timeUs = 6000;
+    recorder.serialWritten(true);
+    recorder.polled(true);
+
+    expect(readTrace(recorder.toBytes())).toEqual([
+      { kind: "yield", polls: 3, yields: 0, timeUs: 5000 },
+      { kind: "serial_backoff", writes: 2, yields: 1, timeUs: 6000 },
+      { kind: "yield", polls: 1, yields: 1, timeUs: 6000 },
+    ]);
+  });
+
+  it("grows with yields rather than polls in a busy loop", () => {
+    // Ten seconds of a busy loop polling every microsecond, yielding every 5ms.
+    let timeUs = 0;
+    const recorder = new TraceRecorder(() => timeUs);
+    let lastYieldUs = 0;
+    for (; timeUs < 10_000_000; timeUs++) {
+      const due = timeUs - lastYieldUs >= 5000;
+      recorder.polled(due);
+      if (due) {
+        recorder.yielded();
+        lastYieldUs = timeUs;
+      }
+    }
+    const yields = 10_000_000 / 5000;
+    expect(readTrace(recorder.toBytes()).length).toEqual(yields - 1);
+    expect(recorder.toBytes().length).toBeLessThan(yields * 8);
+    expect(recorder.truncated).toEqual(false);
+  });
+
+  it("stops recording at the size limit", () => {
+    const recorder = new TraceRecorder(() => 0, 100);
+    for (let i = 0; i < 100; i++) {
+      recorder.record({ kind: "random", word: i });
+    }
+    expect(recorder.truncated).toEqual(true);
+    const events = readTrace(recorder.toBytes());
+    expect(recorder.toBytes().length).toBeLessThan(100 + 10);
+    expect(events.map((e) => e.kind === "random" && e.word)).toEqual(
+      Array.from(Array(events.length), (_, i) => i)
+    );
+  });
+
+  it("rejects other data", () => {
+    expect(() => readTrace(new Uint8Array([1, 2, 3, 4]))).toThrow();
+    const bytes = new TraceRecorder(() => 0);
+    bytes.record({ kind: "serial_input", data: "abc" });
+    expect(() => readTrace(bytes.toBytes().slice(0, -1))).toThrow();
+  });
+});
+
+describe("TracePlayer", () => {
+  it("replays inputs by yield and random words in order", () => {
+    const recorder = new TraceRecorder(() => 0);
+    recorder.record({ kind: "set_value", id: "buttonA", value: 1 });
+    recorder.record({ kind: "random", word: 1 });
+    recorder.yielded();
+    recorder.record({ kind: "random", word: 2 });
+    recorder.yielded();
+    recorder.record({ kind: "serial_input", data: "a" });
+    const player = new TracePlayer(readTrace(recorder.toBytes()));
+
+    expect(player.takeInputs(0).map((e) => e.kind)).toEqual(["set_value"]);
+    expect(player.takeInputs(1)).toEqual([]);
+    expect(player.takeInputs(2).map((e) => e.kind)).toEqual(["serial_input"]);
+    expect(player.nextRandomWord()).toEqual(1);
+    expect(player.nextRandomWord()).toEqual(2);
+    expect(player.nextRandomWord()).toBeUndefined();
+  });
+
+  it("replays yields and serial back offs", () => {
+    let timeUs = 0;
+    const recorder = new TraceRecorder(() => timeUs);
+    recorder.polled(false);
+    timeUs = 10;
+    recorder.polled(true);
+    recorder.yielded();
+    timeUs = 20;
+    recorder.polled(true);
+    recorder.yielded();
+    recorder.serialWritten(false);
+    recorder.serialWritten(true);
+    const player = new TracePlayer(readTrace(recorder.toBytes()));
+
+    expect(player.hasYields()).toEqual(true);
+    expect(player.polled()).toBeUndefined();
+    expect(player.polled()).toEqual(10);
+    player.yielded();
+    expect(player.polled()).toEqual(20);
+    player.yielded();
+    expect(player.hasYields()).toEqual(false);
+    expect(player.polled()).toBeUndefined();
+    expect(player.serialWritten()).toEqual(false);
+    expect(player.serialWritten()).toEqual(true);
+    expect(player.serialWritten()).toEqual(false);
+  });
+});
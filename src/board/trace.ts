@@ -0,0 +1,430 @@
+import { EnumSensor, RangeSensor, State } from "./state";
+
+/**
+ * An input delivered to the program or a value the board gave the HAL.
+ */
+export type TraceInput =
+  | { kind: "set_value"; id: string; value: number | string }
+  | { kind: "serial_input"; data: string }
+  | { kind: "radio_input"; data: Uint8Array }
+  | { kind: "random"; word: number }
+  /**
+   * The HAL yielded between events on this poll, counted from its previous
+   * yield.
+   */
+  | { kind: "yield"; polls: number }
+  /**
+   * The HAL was told to back off on this serial write, counted from the
+   * previous back off.
+   */
+  | { kind: "serial_backoff"; writes: number };
+
+export type TraceEvent = TraceInput & {
+  /**
+   * The number of times the HAL had yielded to the event loop.
+   *
+   * On the main thread inputs only arrive while the HAL is yielded. When the
+   * HAL yields between events depends on the clock, so those yields and the
+   * serial back offs are also recorded. This pins down when the program saw
+   * each input.
+   */
+  yields: number;
+  /**
+   * Microseconds since the program started.
+   */
+  timeUs: number;
+};
+
+/**
+ * The set_value inputs that recreate the sensor values in state.
+ */
+export const stateInputs = (state: Partial<State>): TraceInput[] =>
+  Object.values(state).flatMap((sensor): TraceInput[] =>
+    sensor instanceof RangeSensor || sensor instanceof EnumSensor
+      ? [{ kind: "set_value", id: sensor.id, value: sensor.value }]
+      : []
+  );
+
+export const randomWord = () => (Math.random() * 0x100000000) >>> 0;
+
+// "MBT" then the format version.
+const magic = [0x4d, 0x42, 0x54, 0x01];
+
+enum RecordKind {
+  SetInteger = 0,
+  SetFloat = 1,
+  SetString = 2,
+  SerialInput = 3,
+  RadioInput = 4,
+  Random = 5,
+  Yield = 6,
+  SerialBackoff = 7,
+}
+
+/**
+ * Records a run as a compact binary trace.
+ *
+ * Each record is a kind byte, the yield count and time as deltas from the
+ * previous record in LEB128, then the payload. The HAL yields between events
+ * at most every few milliseconds so a busy program adds a few bytes per
+ * yield. Recording stops once the trace reaches maxBytes.
+ */
+export class TraceRecorder {
+  private buffer = new Uint8Array(1024);
+  private view = new DataView(this.buffer.buffer);
+  private length = 0;
+  private yields = 0;
+  private lastYields = 0;
+  private lastTimeUs = 0;
+  private polls = 0;
+  private serialWrites = 0;
+  private encoder = new TextEncoder();
+
+  /**
+   * Set once the trace is full and later records are dropped.
+   */
+  truncated = false;
+
+  constructor(
+    private timeUs: () => number,
+    private maxBytes: number = 8 * 1024 * 1024
+  ) {
+    this.writeBytes(magic);
+  }
+
+  /**
+   * Called each time the HAL yields to the event loop.
+   */
+  yielded() {
+    this.yields++;
+    this.polls = 0;
+  }
+
+  /**
+   * Called each time the HAL checks whether to yield between events.
+   */
+  polled(due: boolean) {
+    this.polls++;
+    if (due) {
+      this.record({ kind: "yield", polls: this.polls });
+    }
+  }
+
+  /**
+   * Called each time the HAL writes serial output.
+   */
+  serialWritten(backoff: boolean) {
+    this.serialWrites++;
+    if (backoff) {
+      this.record({ kind: "serial_backoff", writes: this.serialWrites });
+      this.serialWrites = 0;
+    }
+  }
+
+  record(input: TraceInput) {
+    if (this.length >= this.maxBytes) {
+      this.truncated = true;
+      return;
+    }
+    this.write(input, this.timeUs());
+  }
+
+  /**
+   * @returns The trace so far.
+   */
+  toBytes(): Uint8Array {
+    return this.buffer.slice(0, this.length);
+  }
+
+  private write(input: TraceInput, timeUs: number) {
+    timeUs = Math.max(this.lastTimeUs, timeUs);
+    switch (input.kind) {
+      case "set_value": {
+        const { value } = input;
+        this.writeByte(
+          typeof value === "string"
+            ? RecordKind.SetString
+            : Number.isInteger(value)
+            ? RecordKind.SetInteger
+            : RecordKind.SetFloat
+        );
+        break;
+      }
+      case "serial_input":
+        this.writeByte(RecordKind.SerialInput);
+        break;
+      case "radio_input":
+        this.writeByte(RecordKind.RadioInput);
+        break;
+      case "random":
+        this.writeByte(RecordKind.Random);
+        break;
+      case "yield":
+        this.writeByte(RecordKind.Yield);
+        break;
+      case "serial_backoff":
+        this.writeByte(RecordKind.SerialBackoff);
+        break;
+    }
+    this.writeVarint(this.yields - this.lastYields);
+    this.writeVarint(timeUs - this.lastTimeUs);
+    this.lastYields = this.yields;
+    this.lastTimeUs = timeUs;
+    switch (input.kind) {
+      case "set_value": {
+        this.writeBytes(this.encoder.encode(input.id), true);
+        const { value } = input;
+        if (typeof value === "string") {
+          this.writeBytes(this.encoder.encode(value), true);
+        } else if (Number.isInteger(value)) {
+          // Zigzag so small negative values stay small.
+          this.writeVarint(value < 0 ? -2 * value - 1 : 2 * value);
+        } else {
+          this.reserve(8);
+          this.view.setFloat64(this.length, value, true);
+          this.length += 8;
+        }
+        break;
+      }
+      case "serial_input":
+        this.writeBytes(this.encoder.encode(input.data), true);
+        break;
+      case "radio_input":
+        this.writeBytes(input.data, true);
+        break;
+      case "random":
+        this.reserve(4);
+        this.view.setUint32(this.length, input.word, true);
+        this.length += 4;
+        break;
+      case "yield":
+        this.writeVarint(input.polls);
+        break;
+      case "serial_backoff":
+        this.writeVarint(input.writes);
+        break;
+    }
+  }
+
+  private reserve(n: number) {
+    if (this.length + n > this.buffer.length) {
+      const buffer = new Uint8Array(
+        Math.max(this.buffer.length * 2, this.length + n)
+      );
+      buffer.set(this.buffer.subarray(0, this.length));
+      this.buffer = buffer;
+      this.view = new DataView(buffer.buffer);
+    }
+  }
+
+  private writeByte(value: number) {
+    this.reserve(1);
+    this.buffer[this.length++] = value;
+  }
+
+  private writeVarint(value: number) {
+    do {
+      let byte = value % 0x80;
+      value = Math.floor(value / 0x80);
+      if (value > 0) {
+        byte |= 0x80;
+      }
+      this.writeByte(byte);
+    } while (value > 0);
+  }
+
+  private writeBytes(bytes: ArrayLike<number>, withLength: boolean = false) {
+    if (withLength) {
+      this.writeVarint(bytes.length);
+    }
+    this.reserve(bytes.length);
+    this.buffer.set(bytes, this.length);
+    this.length += bytes.length;
+  }
+}
+
+/**
+ * Decode a trace written by TraceRecorder.
+ */
+export const readTrace = (bytes: Uint8Array): TraceEvent[] => {
+  const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+  const decoder = new TextDecoder();
+  let offset = 0;
+  const check = (n: number) => {
+    if (offset + n > bytes.length) {
+      throw new Error("Truncated trace");
+    }
+  };
+  const readVarint = () => {
+    let result = 0;
+    let scale = 1;
+    let byte: number;
+    do {
+      check(1);
+      byte = bytes[offset++];
+      result += (byte & 0x7f) * scale;
+      scale *= 0x80;
+    } while (byte & 0x80);
+    return result;
+  };
+  const readBytes = () => {
+    const length = readVarint();
+    check(length);
+    const result = bytes.slice(offset, offset + length);
+    offset += length;
+    return result;
+  };
+  const readString = () => decoder.decode(readBytes());
+
+  if (!magic.every((b, i) => bytes[i] === b)) {
+    throw new Error("Not a trace or unsupported version");
+  }
+  offset = magic.length;
+  const events: TraceEvent[] = [];
+  let yields = 0;
+  let timeUs = 0;
+  while (offset < bytes.length) {
+    const kind = bytes[offset++];
+    yields += readVarint();
+    timeUs += readVarint();
+    let input: TraceInput;
+    switch (kind) {
+      case RecordKind.SetInteger: {
+        const id = readString();
+        const zigzag = readVarint();
+        const value = zigzag % 2 ? -(zigzag + 1) / 2 : zigzag / 2;
+        input = { kind: "set_value", id, value };
+        break;
+      }
+      case RecordKind.SetFloat: {
+        const id = readString();
+        check(8);
+        const value = view.getFloat64(offset, true);
+        offset += 8;
+        input = { kind: "set_value", id, value };
+        break;
+      }
+      case RecordKind.SetString: {
+        const id = readString();
+        input = { kind: "set_value", id, value: readString() };
+        break;
+      }
+      case RecordKind.SerialInput:
+        input = { kind: "serial_input", data: readString() };
+        break;
+      case RecordKind.RadioInput:
+        input = { kind: "radio_input", data: readBytes() };
+        break;
+      case RecordKind.Random:
+        check(4);
+        input = { kind: "random", word: view.getUint32(offset, true) };
+        offset += 4;
+        break;
+      case RecordKind.Yield:
+        input = { kind: "yield", polls: readVarint() };
+        break;
+      case RecordKind.SerialBackoff:
+        input = { kind: "serial_backoff", writes: readVarint() };
+        break;
+      default:
+        throw new Error(`Unknown trace record kind: ${kind}`);
+    }
+    events.push({ ...input, yields, timeUs });
+  }
+  return events;
+};
+
+/**
+ * Feeds a trace back to a board in the order it was recorded.
+ */
+export class TracePlayer {
+  private inputs: TraceEvent[];
+  private randomWords: number[];
+  private yieldEvents: TraceEvent[];
+  private serialBackoffs: number[];
+  private inputIndex = 0;
+  private randomIndex = 0;
+  private yieldIndex = 0;
+  private polls = 0;
+  private serialBackoffIndex = 0;
+  private serialWrites = 0;
+
+  constructor(events: TraceEvent[]) {
+    this.inputs = events.filter(
+      (e) =>
+        e.kind === "set_value" ||
+        e.kind === "serial_input" ||
+        e.kind === "radio_input"
+    );
+    this.randomWords = events.flatMap((e) =>
+      e.kind === "random" ? [e.word] : []
+    );
+    this.yieldEvents = events.filter((e) => e.kind === "yield");
+    this.serialBackoffs = events.flatMap((e) =>
+      e.kind === "serial_backoff" ? [e.writes] : []
+    );
+  }
+
+  /**
+   * @returns The inputs delivered up to and including the given yield.
+   */
+  takeInputs(yields: number): TraceEvent[] {
+    const start = this.inputIndex;
+    while (
+      this.inputIndex < this.inputs.length &&
+      this.inputs[this.inputIndex].yields <= yields
+    ) {
+      this.inputIndex++;
+    }
+    return this.inputs.slice(start, this.inputIndex);
+  }
+
+  /**
+   * @returns The next recorded random word or undefined if we've run out.
+   */
+  nextRandomWord(): number | undefined {
+    return this.randomWords[this.randomIndex++];
+  }
+
+  /**
+   * @returns true if there are yields between events left to replay.
+   */
+  hasYields(): boolean {
+    return this.yieldIndex < this.yieldEvents.length;
+  }
+
+  /**
+   * Called each time the HAL yields to the event loop.
+   */
+  yielded() {
+    this.polls = 0;
+  }
+
+  /**
+   * Called each time the HAL checks whether to yield between events.
+   *
+   * @returns The recorded time in microseconds if the HAL yielded on this
+   * poll, otherwise undefined.
+   */
+  polled(): number | undefined {
+    const event = this.yieldEvents[this.yieldIndex];
+    if (event?.kind === "yield" && ++this.polls === event.polls) {
+      this.yieldIndex++;
+      return event.timeUs;
+    }
+    return undefined;
+  }
+
+  /**
+   * @returns true if the HAL was told to back off on this serial write.
+   */
+  serialWritten(): boolean {
+    const writes = this.serialBackoffs[this.serialBackoffIndex];
+    if (writes !== undefined && ++this.serialWrites === writes) {
+      this.serialBackoffIndex++;
+      this.serialWrites = 0;
+      return true;
+    }
+    return false;
+  }
+}
@@ -7,3 +7,9 @@ export function clamp(value: number, min: number, max: number) {
   }
   return value;
 }
+
+export const promisify = <T>(request: IDBRequest<T>): Promise<T> =>
+  new Promise((resolve, reject) => {
+    request.onsuccess = () => resolve(request.result);
+    request.onerror = () => reject(request.error);
+  });
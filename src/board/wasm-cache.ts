@@ -0,0 +1,135 @@
+import { promisify } from "./util";
+
+const dbName = "simulator-wasm";
+const storeName = "modules";
+
+/**
+ * The compiled firmware.
+ */
+export interface CompiledWasm {
+  module: WebAssembly.Module;
+  /**
+   * A hash of the Wasm that identifies the build.
+   */
+  build: string;
+}
+
+interface PersistedModule extends CompiledWasm {
+  version: string;
+}
+
+/**
+ * Fetch and compile the firmware Wasm.
+ *
+ * Compiles while downloading where the browser supports it. If a version is
+ * given the compiled module is also persisted to IndexedDB, keyed by URL, and
+ * reused while the version matches. Few browsers can store a module so this
+ * quietly does nothing elsewhere, where the browser's own code cache for
+ * streamed compiles of cached responses is the fast path. The download starts
+ * alongside the lookup so a miss costs nothing extra.
+ *
+ * The build hash is stored with the module so a hit needn't download the Wasm
+ * to key the bytecode cache.
+ */
+export const compileWasm = async (
+  url: string,
+  cacheVersion: string | undefined
+): Promise<CompiledWasm> => {
+  const key = new URL(url, self.location.href).href;
+  const dbPromise = cacheVersion ? openDb() : Promise.resolve(undefined);
+  const abort = new AbortController();
+  const compiled = fetchAndCompile(url, abort.signal);
+  // Awaited below unless there's a hit, when it fails with the abort.
+  compiled.catch(() => {});
+  const db = await dbPromise;
+  if (db) {
+    const cached = await getModule(db, key, cacheVersion!);
+    if (cached) {
+      abort.abort();
+      return cached;
+    }
+  }
+  const result = await compiled;
+  if (db) {
+    try {
+      const entry: PersistedModule = { ...result, version: cacheVersion! };
+      const transaction = db.transaction(storeName, "readwrite");
+      transaction.objectStore(storeName).put(entry, key);
+    } catch (e) {
+      // Ignore, typically DataCloneError where modules can't be stored.
+    }
+  }
+  return result;
+};
+
+const fetchAndCompile = async (
+  url: string,
+  signal: AbortSignal
+): Promise<CompiledWasm> => {
+  const response = await fetch(url, { signal });
+  if (!response.ok) {
+    throw new Error(response.statusText);
+  }
+  // Hash a copy of the download while compiling from the stream.
+  const [module, build] = await Promise.all([
+    compileResponse(response.clone()),
+    response.arrayBuffer().then(firmwareBuild),
+  ]);
+  return { module, build };
+};
+
+const compileResponse = async (
+  response: Response
+): Promise<WebAssembly.Module> => {
+  // Not in Safari 14.
+  if (typeof WebAssembly.compileStreaming === "function") {
+    try {
+      return await WebAssembly.compileStreaming(response.clone());
+    } catch (e) {
+      // E.g. the server didn't send application/wasm. Fall back to a buffer.
+    }
+  }
+  return WebAssembly.compile(await response.arrayBuffer());
+};
+
+const firmwareBuild = async (wasm: ArrayBuffer): Promise<string> => {
+  const digest = new Uint8Array(await crypto.subtle.digest("SHA-256", wasm));
+  return Array.from(digest, (b) => b.toString(16).padStart(2, "0")).join("");
+};
+
+const openDb = async (): Promise<IDBDatabase | undefined> => {
+  if (typeof indexedDB === "undefined") {
+    return undefined;
+  }
+  try {
+    const request = indexedDB.open(dbName, 1);
+    request.onupgradeneeded = () => {
+      request.result.createObjectStore(storeName);
+    };
+    return await promisify(request);
+  } catch (e) {
+    // Caching is an optimisation so carry on without it.
+    return undefined;
+  }
+};
+
+const getModule = async (
+  db: IDBDatabase,
+  key: string,
+  version: string
+): Promise<CompiledWasm | undefined> => {
+  try {
+    const store = db.transaction(storeName, "readonly").objectStore(storeName);
+    const entry: PersistedModule | undefined = await promisify(store.get(key));
+    if (
+      entry?.version === version &&
+      entry.module instanceof WebAssembly.Module &&
+      typeof entry.build === "string"
+    ) {
+      return { module: entry.module, build: entry.build };
+    }
+  } catch (e) {
+    // As for a miss.
+  }
+  return undefined;
+};
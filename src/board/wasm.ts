@@ -1,6 +1,38 @@
 import { Board } from ".";
+import { Accelerometer } from "./accelerometer";
+import { BytecodeCache } from "./bytecode-cache";
+import { Compass } from "./compass";
+import {
+  MICROBIT_HAL_PIN_FACE,
+  MICROBIT_HAL_PIN_P0,
+  MICROBIT_HAL_PIN_P1,
+  MICROBIT_HAL_PIN_P2,
+  MICROBIT_HAL_SENSOR_ACCELEROMETER_X,
+  MICROBIT_HAL_SENSOR_ACCELEROMETER_Y,
+  MICROBIT_HAL_SENSOR_ACCELEROMETER_Z,
+  MICROBIT_HAL_SENSOR_BUTTON_A,
+  MICROBIT_HAL_SENSOR_BUTTON_B,
+  MICROBIT_HAL_SENSOR_COMPASS_HEADING,
+  MICROBIT_HAL_SENSOR_COMPASS_X,
+  MICROBIT_HAL_SENSOR_COMPASS_Y,
+  MICROBIT_HAL_SENSOR_COMPASS_Z,
+  MICROBIT_HAL_SENSOR_COUNT,
+  MICROBIT_HAL_SENSOR_GESTURE,
+  MICROBIT_HAL_SENSOR_LIGHT_LEVEL,
+  MICROBIT_HAL_SENSOR_PIN_LOGO,
+  MICROBIT_HAL_SENSOR_PIN_P0,
+  MICROBIT_HAL_SENSOR_PIN_P1,
+  MICROBIT_HAL_SENSOR_PIN_P2,
+  MICROBIT_HAL_SENSOR_SOUND_LEVEL,
+  MICROBIT_HAL_SENSOR_TEMPERATURE,
+} from "./constants";
 import * as conversions from "./conversions";
 import { FileSystem } from "./fs";
+import { HeadlessBoard } from "./headless-board";
+import { Pin } from "./pins";
+import { RangeSensor, State } from "./state";
+import { clamp } from "./util";
+import { WorkerBoard } from "./worker-board";
 
 export interface EmscriptenModule {
   cwrap: any;
@@ -9,35 +41,130 @@ export interface EmscriptenModule {
   // See EXPORTED_FUNCTIONS in the Makefile.
   _mp_js_request_stop(): void;
   _mp_js_force_stop(): void;
+  _mp_js_gc_stats(): number;
   _microbit_hal_audio_ready_callback(): void;
   _microbit_hal_audio_speech_ready_callback(): void;
+  _microbit_hal_audio_expression_ready_callback(): void;
   _microbit_hal_gesture_callback(gesture: number): void;
   _microbit_hal_level_detector_callback(level: number): void;
-  _microbit_radio_rx_buffer(): number;
+  _microbit_hal_sensor_registers(): number;
 
   HEAPU8: Uint8Array;
+  HEAPF32: Float32Array;
 
   // Added by us at module creation time for jshal to access.
-  board: Board;
+  board: Board | WorkerBoard | HeadlessBoard;
   fs: FileSystem;
+  bytecodeCache: BytecodeCache;
   conversions: typeof conversions;
 }
 
+export class PanicError extends Error {
+  constructor(public code: number) {
+    super("panic");
+  }
+}
+
+export class ResetError extends Error {
+  constructor() {
+    super("reset");
+  }
+}
+
+/**
+ * The default MicroPython GC heap size in bytes, as on a micro:bit.
+ */
+export const defaultHeapSize = 64 * 1024;
+
+const minHeapSize = 16 * 1024;
+// The Wasm memory doesn't grow so leave room for everything else.
+const maxHeapSize = 8 * 1024 * 1024;
+
+/**
+ * Clamp a requested heap size to what the firmware supports.
+ */
+export const validHeapSize = (heapSize: number): number =>
+  clamp(Math.floor(heapSize), minHeapSize, maxHeapSize);
+
+/**
+ * How often to report GcStats while running.
+ */
+export const gcStatsIntervalMs = 1000;
+
+/**
+ * Garbage collector statistics for a run.
+ */
+export interface GcStats {
+  /**
+   * The heap allocated, which is smaller than requested if there wasn't the
+   * memory.
+   */
+  heapSize: number;
+  collections: number;
+  /**
+   * Total time spent collecting.
+   */
+  collectTimeMs: number;
+  /**
+   * The most heap left in use after a collection or at the end of the run.
+   */
+  peakUsed: number;
+  used: number;
+  free: number;
+  /**
+   * 0 if the free heap is one block, approaching 1 as it splits up.
+   */
+  fragmentation: number;
+}
+
 export class ModuleWrapper {
-  private main: () => Promise<void>;
+  private main: (heapSize: number) => Promise<void>;
 
-  constructor(private module: EmscriptenModule) {
+  /**
+   * Scalar sensor values read by the HAL, see microbithal_js.h.
+   */
+  sensorRegisters: Int32Array;
+
+  constructor(readonly module: EmscriptenModule) {
     const main = module.cwrap("mp_js_main", "null", ["number"], {
       async: true,
     });
-    this.main = () => main(64 * 1024);
+    this.main = main;
+    // The heap doesn't grow so the view remains valid.
+    this.sensorRegisters = new Int32Array(
+      module.HEAPU8.buffer,
+      module._microbit_hal_sensor_registers(),
+      MICROBIT_HAL_SENSOR_COUNT
+    );
   }
 
   /**
    * Throws PanicError if MicroPython panics.
    */
-  async start(): Promise<void> {
-    return this.main!();
+  async start(heapSize: number = defaultHeapSize): Promise<void> {
+    return this.main(heapSize);
+  }
+
+  /**
+   * Statistics for the current or last run, see mp_js_gc_stats_t in main.c.
+   */
+  gcStats(): GcStats {
+    const stats = new Uint32Array(
+      this.module.HEAPU8.buffer,
+      this.module._mp_js_gc_stats(),
+      7
+    );
+    const free = stats[5];
+    const maxFree = stats[6];
+    return {
+      heapSize: stats[0],
+      collections: stats[1],
+      collectTimeMs: stats[2] / 1000,
+      peakUsed: stats[3],
+      used: stats[4],
+      free,
+      fragmentation: free > 0 ? 1 - maxFree / free : 0,
+    };
   }
 
   requestStop(): void {
@@ -47,10 +174,109 @@ export class ModuleWrapper {
   forceStop(): void {
     this.module._mp_js_force_stop();
   }
+}
 
-  writeRadioRxBuffer(packet: Uint8Array) {
-    const buf = this.module._microbit_radio_rx_buffer!();
-    this.module.HEAPU8.set(packet, buf);
-    return buf;
-  }
+/**
+ * Copy sensor values into the registers the HAL reads, see microbithal_js.h.
+ */
+export const writeSensorRegisters = (
+  registers: Int32Array,
+  state: Omit<State, "radio" | "dataLogging">
+) => {
+  registers[MICROBIT_HAL_SENSOR_ACCELEROMETER_X] = state.accelerometerX.value;
+  registers[MICROBIT_HAL_SENSOR_ACCELEROMETER_Y] = state.accelerometerY.value;
+  registers[MICROBIT_HAL_SENSOR_ACCELEROMETER_Z] = state.accelerometerZ.value;
+  registers[MICROBIT_HAL_SENSOR_GESTURE] =
+    conversions.convertAccelerometerStringToNumber(state.gesture.value);
+  registers[MICROBIT_HAL_SENSOR_COMPASS_X] = state.compassX.value;
+  registers[MICROBIT_HAL_SENSOR_COMPASS_Y] = state.compassY.value;
+  registers[MICROBIT_HAL_SENSOR_COMPASS_Z] = state.compassZ.value;
+  registers[MICROBIT_HAL_SENSOR_COMPASS_HEADING] = state.compassHeading.value;
+  registers[MICROBIT_HAL_SENSOR_TEMPERATURE] = state.temperature.value;
+  registers[MICROBIT_HAL_SENSOR_LIGHT_LEVEL] = state.lightLevel.value;
+  registers[MICROBIT_HAL_SENSOR_SOUND_LEVEL] = state.soundLevel.value;
+  registers[MICROBIT_HAL_SENSOR_BUTTON_A] = state.buttonA.value;
+  registers[MICROBIT_HAL_SENSOR_BUTTON_B] = state.buttonB.value;
+  registers[MICROBIT_HAL_SENSOR_PIN_LOGO] = state.pinLogo.value;
+  registers[MICROBIT_HAL_SENSOR_PIN_P0] = state.pin0.value;
+  registers[MICROBIT_HAL_SENSOR_PIN_P1] = state.pin1.value;
+  registers[MICROBIT_HAL_SENSOR_PIN_P2] = state.pin2.value;
+};
+
+/**
+ * The inputs setSensorValue updates.
+ */
+export interface SensorInputs {
+  accelerometer: Accelerometer;
+  compass: Compass;
+  buttons: { setValue(value: any): void }[];
+  pins: Pin[];
+  lightLevel: RangeSensor;
+  microphone: { setValue(value: number): void };
+  temperature: RangeSensor;
 }
+
+/**
+ * Set a sensor, button or pin value using its id in State.
+ *
+ * @returns false if the id is unknown.
+ */
+export const setSensorValue = (
+  inputs: SensorInputs,
+  id: string,
+  value: any
+): boolean => {
+  switch (id) {
+    case "accelerometerX":
+    case "accelerometerY":
+    case "accelerometerZ":
+    case "gesture": {
+      inputs.accelerometer.setValue(id, value);
+      return true;
+    }
+    case "compassX":
+    case "compassY":
+    case "compassZ":
+    case "compassHeading": {
+      inputs.compass.setValue(id, value);
+      return true;
+    }
+    case "buttonA": {
+      inputs.buttons[0].setValue(value);
+      return true;
+    }
+    case "buttonB": {
+      inputs.buttons[1].setValue(value);
+      return true;
+    }
+    case "pinLogo": {
+      inputs.pins[MICROBIT_HAL_PIN_FACE].setValue(value);
+      return true;
+    }
+    case "pin0": {
+      inputs.pins[MICROBIT_HAL_PIN_P0].setValue(value);
+      return true;
+    }
+    case "pin1": {
+      inputs.pins[MICROBIT_HAL_PIN_P1].setValue(value);
+      return true;
+    }
+    case "pin2": {
+      inputs.pins[MICROBIT_HAL_PIN_P2].setValue(value);
+      return true;
+    }
+    case "lightLevel": {
+      inputs.lightLevel.setValue(value);
+      return true;
+    }
+    case "soundLevel": {
+      inputs.microphone.setValue(value);
+      return true;
+    }
+    case "temperature": {
+      inputs.temperature.setValue(value);
+      return true;
+    }
+  }
+  return false;
+};
@@ -0,0 +1,278 @@
+import { DataLogging } from "./data-logging";
+import { StubPin } from "./pins";
+import { Radio } from "./radio";
+import { SerialInputBuffer } from "./serial-input";
+import { randomWord } from "./trace";
+import {
+  gcStatsIntervalMs,
+  ModuleWrapper,
+  PanicError,
+  ResetError,
+} from "./wasm";
+import {
+  AudioStream,
+  FromWorkerMessage,
+  SharedState,
+} from "./worker-protocol";
+
+type PostMessage = (
+  message: FromWorkerMessage,
+  transfer?: Transferable[]
+) => void;
+
+// Waits for the UI to read serial output are bounded so that we retry even if
+// it read between our write and the wait.
+const serialOutputWaitMs = 50;
+
+/**
+ * The board as seen by the HAL when running in a worker.
+ *
+ * Mirrors the parts of Board that jshal.js uses. Input is read from shared
+ * memory written by the UI thread. Output is written to shared memory or
+ * posted as a message. See WorkerModule for the UI side.
+ */
+export class WorkerBoard {
+  display: WorkerDisplay;
+  buttons: WorkerButton[];
+  pins: StubPin[];
+  audio: WorkerAudio;
+  accelerometer: WorkerAccelerometer;
+  microphone: WorkerMicrophone;
+  radio: Radio;
+  dataLogging: DataLogging;
+
+  /**
+   * Defined while a program is running.
+   */
+  module: ModuleWrapper | undefined;
+
+  private epoch: number | undefined;
+  private encoder = new TextEncoder();
+  private serialInput = new SerialInputBuffer();
+  private serialInputChunk = new Uint8Array(4096);
+  private lastGcStatsMs = -Infinity;
+
+  constructor(private shared: SharedState, private post: PostMessage) {
+    this.display = new WorkerDisplay(shared);
+    this.buttons = [new WorkerButton(shared, 0), new WorkerButton(shared, 1)];
+    this.pins = Array.from(Array(33), (_, i) => new StubPin(`pin${i}`));
+    this.audio = new WorkerAudio(post);
+    this.accelerometer = new WorkerAccelerometer(post);
+    this.microphone = new WorkerMicrophone(post);
+
+    const currentTimeMillis = this.ticksMilliseconds.bind(this);
+    this.radio = new Radio(
+      (data) => shared.radioOutput.writeMessage(data),
+      (change) => post({ kind: "state_change", change }),
+      currentTimeMillis
+    );
+    this.dataLogging = new DataLogging(
+      currentTimeMillis,
+      (entry) => post({ kind: "log_output", entry }),
+      (text) => this.writeSerialOutput(text),
+      () => post({ kind: "log_delete" }),
+      (change) => post({ kind: "state_change", change })
+    );
+  }
+
+  /**
+   * Milliseconds since the program started, from a monotonic clock.
+   */
+  ticksMilliseconds() {
+    return Math.floor(this.ticksMicroseconds() / 1000);
+  }
+
+  /**
+   * Microseconds since the program started, from a monotonic clock.
+   */
+  ticksMicroseconds() {
+    return Math.floor((performance.now() - this.epoch!) * 1000);
+  }
+
+  randomWord(): number {
+    return randomWord();
+  }
+
+  /**
+   * Called before the HAL sleeps for ms, yielding to the event loop.
+   *
+   * @returns true to really sleep.
+   */
+  sleep(ms: number): boolean {
+    return true;
+  }
+
+  /**
+   * Called each time the HAL checks whether to yield between events.
+   *
+   * @param due Whether the HAL has used up its time slice.
+   * @returns true to yield.
+   */
+  shouldYield(due: boolean): boolean {
+    return due;
+  }
+
+  /**
+   * Read serial input into target, see SerialInputBuffer.read.
+   *
+   * The HAL calls this every time it processes events so we also pick up
+   * other input here.
+   */
+  readSerialInput(target: Uint8Array, interruptChar: number): number {
+    this.module?.sensorRegisters.set(this.shared.sensors);
+    this.receiveRadio();
+    // Drain the ring so we can look for the interrupt in all the input.
+    const ring = this.shared.serialInput;
+    const chunk = this.serialInputChunk;
+    for (let length = ring.read(chunk); length > 0; length = ring.read(chunk)) {
+      this.serialInput.write(chunk.slice(0, length));
+    }
+    return this.serialInput.read(target, interruptChar);
+  }
+
+  /**
+   * Blocks until the UI has read all the output, so output is never dropped
+   * and the HAL is never asked to back off.
+   */
+  writeSerialOutput(text: string): boolean {
+    let data = this.encoder.encode(text);
+    const ring = this.shared.serialOutput;
+    while (data.length > 0) {
+      data = data.subarray(ring.write(data));
+      if (data.length > 0) {
+        // The UI may not be polling, e.g. in a hidden tab.
+        this.post({ kind: "serial_output_full" });
+        ring.waitForRead(serialOutputWaitMs);
+      }
+    }
+    return false;
+  }
+
+  throwPanic(code: number): void {
+    throw new PanicError(code);
+  }
+
+  throwReset(): void {
+    throw new ResetError();
+  }
+
+  programFinished() {}
+
+  gcCollected() {
+    const now = performance.now();
+    if (this.module && now - this.lastGcStatsMs >= gcStatsIntervalMs) {
+      this.lastGcStatsMs = now;
+      this.post({ kind: "gc_stats", stats: this.module.gcStats() });
+    }
+  }
+
+  initialize() {
+    this.epoch = performance.now();
+    this.module?.sensorRegisters.set(this.shared.sensors);
+    this.shared.serialInput.discard();
+    this.serialInput.clear();
+  }
+
+  stopComponents() {
+    this.buttons.forEach((b) => b.boardStopped());
+    this.pins.forEach((p) => p.boardStopped());
+    this.radio.boardStopped();
+    this.dataLogging.boardStopped();
+    this.shared.radioInput.discard();
+  }
+
+  private receiveRadio() {
+    const ring = this.shared.radioInput;
+    for (let data = ring.readMessage(); data; data = ring.readMessage()) {
+      // As for a real radio, anything sent while we're disabled is lost.
+      if (this.radio.state.enabled) {
+        this.radio.receive(data);
+      }
+    }
+  }
+}
+
+class WorkerDisplay {
+  constructor(private shared: SharedState) {}
+
+  setFrame(frame: Uint8Array) {
+    this.shared.displayFrame.set(frame);
+    Atomics.add(this.shared.displayCounter, 0, 1);
+  }
+}
+
+class WorkerButton {
+  constructor(private shared: SharedState, private index: number) {}
+
+  getAndClearPresses() {
+    return Atomics.exchange(this.shared.buttonPresses, this.index, 0);
+  }
+
+  boardStopped() {
+    Atomics.store(this.shared.buttonPresses, this.index, 0);
+  }
+}
+
+class WorkerAccelerometer {
+  constructor(private post: PostMessage) {}
+
+  setRange(range: number) {
+    this.post({ kind: "accelerometer_range", range });
+  }
+}
+
+class WorkerMicrophone {
+  constructor(private post: PostMessage) {}
+
+  microphoneOn() {
+    this.post({ kind: "microphone_on" });
+  }
+
+  setThreshold(threshold: "low" | "high", value: number) {
+    this.post({ kind: "microphone_threshold", threshold, value });
+  }
+}
+
+class WorkerAudio {
+  default: WorkerBufferedAudio;
+  speech: WorkerBufferedAudio;
+  soundExpression: WorkerBufferedAudio;
+
+  constructor(private post: PostMessage) {
+    this.default = new WorkerBufferedAudio("default", post);
+    this.speech = new WorkerBufferedAudio("speech", post);
+    this.soundExpression = new WorkerBufferedAudio("soundExpression", post);
+  }
+
+  setVolume(volume: number) {
+    this.post({ kind: "audio_volume", volume });
+  }
+
+  setPeriodUs(periodUs: number) {
+    this.post({ kind: "audio_period", periodUs });
+  }
+
+  setAmplitudeU10(amplitudeU10: number) {
+    this.post({ kind: "audio_amplitude", amplitudeU10 });
+  }
+}
+
+/**
+ * Samples are converted here and posted to the UI which owns the
+ * AudioContext. The UI posts back when it's ready for more.
+ */
+class WorkerBufferedAudio {
+  constructor(private stream: AudioStream, private post: PostMessage) {}
+
+  init(sampleRate: number) {
+    this.post({ kind: "audio_init", stream: this.stream, sampleRate });
+  }
+
+  writeSamples(samples: Float32Array) {
+    // Copy out of module memory so we can transfer it.
+    const data = samples.slice();
+    this.post({ kind: "audio_data", stream: this.stream, data }, [
+      data.buffer,
+    ]);
+  }
+}
@@ -0,0 +1,289 @@
+import { Board, Firmware, Notifications } from ".";
+import { Button } from "./buttons";
+import { SerialInputBuffer } from "./serial-input";
+import { PanicError, ResetError } from "./wasm";
+import {
+  AudioStream,
+  FromWorkerMessage,
+  SharedState,
+  ToWorkerMessage,
+} from "./worker-protocol";
+
+// Animation frames don't run in hidden tabs so we also poll on a timer.
+const pollTimeoutMs = 100;
+
+/**
+ * Runs MicroPython in a worker so that busy programs don't block the page.
+ *
+ * Used in place of a ModuleWrapper when the worker flag is enabled. The
+ * worker and its filesystem last for the lifetime of the board with a new
+ * Wasm module created for each run.
+ *
+ * Requires cross-origin isolation for SharedArrayBuffer.
+ */
+export class WorkerModule {
+  /**
+   * Scalar sensor values read by the HAL, see microbithal_js.h.
+   */
+  sensorRegisters: Int32Array;
+
+  private worker: Worker;
+  private shared = SharedState.create();
+  private ready: Promise<void>;
+  private onReady: (() => void) | undefined;
+  private running:
+    | { resolve: () => void; reject: (e: any) => void }
+    | undefined;
+  private pollRequest: number | undefined;
+  private pollTimeout: ReturnType<typeof setTimeout> | undefined;
+  private displayCounter = 0;
+  // Input waiting for space in the shared ring.
+  private serialInput = new SerialInputBuffer();
+  private serialInputChunk = new Uint8Array(4096);
+  private serialOutput = new Uint8Array(4096);
+  private decoder = new TextDecoder();
+
+  static isSupported(): boolean {
+    return typeof SharedArrayBuffer !== "undefined" && crossOriginIsolated;
+  }
+
+  constructor(
+    private board: Board,
+    private notifications: Notifications,
+    firmware: Firmware,
+    persistentBytecodeCache: boolean,
+    wasmCacheVersion: string | undefined
+  ) {
+    this.sensorRegisters = this.shared.sensors;
+    this.ready = new Promise((resolve) => {
+      this.onReady = resolve;
+    });
+    this.worker = new Worker("./build/worker.js");
+    this.worker.addEventListener("message", (e) => this.handleMessage(e.data));
+    this.post({
+      kind: "init",
+      firmware,
+      buffers: this.shared.buffers,
+      persistentBytecodeCache,
+      wasmCacheVersion,
+    });
+  }
+
+  async initialize(): Promise<WorkerModule> {
+    await this.ready;
+    return this;
+  }
+
+  /**
+   * Throws PanicError if MicroPython panics.
+   */
+  async start(heapSize: number): Promise<void> {
+    const stopped = new Promise<void>((resolve, reject) => {
+      this.running = { resolve, reject };
+    });
+    // As for the main thread, input from a previous run is discarded.
+    this.serialInput.clear();
+    this.post({ kind: "start", heapSize });
+    this.poll();
+    return stopped;
+  }
+
+  requestStop(): void {
+    this.post({ kind: "stop" });
+  }
+
+  forceStop(): void {
+    // The worker has already stopped by the time start() completes.
+  }
+
+  flash(filesystem: Record<string, Uint8Array>) {
+    this.post({ kind: "flash", filesystem });
+  }
+
+  writeSerialInput(text: string) {
+    this.serialInput.writeText(text);
+    this.transferSerialInput();
+  }
+
+  receiveRadio(data: Uint8Array) {
+    this.shared.radioInput.writeMessage(data);
+  }
+
+  /**
+   * Move presses recorded by the UI to shared memory where the HAL reads them.
+   */
+  addButtonPresses(buttons: Button[]) {
+    buttons.forEach((button, i) => {
+      Atomics.add(this.shared.buttonPresses, i, button.getAndClearPresses());
+    });
+  }
+
+  gestureCallback = (gesture: number) => {
+    this.post({ kind: "gesture", gesture });
+  };
+
+  levelDetectorCallback = (level: number) => {
+    this.post({ kind: "level_detector", level });
+  };
+
+  audioReadyCallback = (stream: AudioStream) => {
+    this.post({ kind: "audio_ready", stream });
+  };
+
+  private post(message: ToWorkerMessage) {
+    this.worker.postMessage(message);
+  }
+
+  private transferSerialInput() {
+    const ring = this.shared.serialInput;
+    const space = Math.min(ring.space(), this.serialInputChunk.length);
+    const chunk = this.serialInputChunk.subarray(0, space);
+    // The worker handles the interrupt character.
+    const length = this.serialInput.read(chunk, -1);
+    ring.write(chunk.subarray(0, length));
+  }
+
+  private poll = () => {
+    this.cancelPoll();
+    this.transferSerialInput();
+
+    const counter = Atomics.load(this.shared.displayCounter, 0);
+    if (counter !== this.displayCounter) {
+      this.displayCounter = counter;
+      this.board.display.setFrame(this.shared.displayFrame.slice());
+    }
+
+    this.readOutput();
+
+    if (this.running) {
+      this.pollRequest = requestAnimationFrame(this.poll);
+      this.pollTimeout = setTimeout(this.poll, pollTimeoutMs);
+    }
+  };
+
+  private cancelPoll() {
+    if (this.pollRequest !== undefined) {
+      cancelAnimationFrame(this.pollRequest);
+      this.pollRequest = undefined;
+    }
+    if (this.pollTimeout !== undefined) {
+      clearTimeout(this.pollTimeout);
+      this.pollTimeout = undefined;
+    }
+  }
+
+  private readOutput() {
+    const { serialOutput, radioOutput } = this.shared;
+    let text = "";
+    for (
+      let length = serialOutput.read(this.serialOutput);
+      length > 0;
+      length = serialOutput.read(this.serialOutput)
+    ) {
+      text += this.decoder.decode(this.serialOutput.subarray(0, length), {
+        stream: true,
+      });
+    }
+    if (text) {
+      this.board.writeSerialOutput(text);
+    }
+
+    for (
+      let packet = radioOutput.readMessage();
+      packet;
+      packet = radioOutput.readMessage()
+    ) {
+      this.notifications.onRadioOutput(packet);
+    }
+  }
+
+  private handleMessage(message: FromWorkerMessage) {
+    const { board } = this;
+    switch (message.kind) {
+      case "ready": {
+        this.onReady!();
+        break;
+      }
+      case "serial_output_full": {
+        this.readOutput();
+        break;
+      }
+      case "gc_stats": {
+        this.notifications.onGcStats(message.stats);
+        break;
+      }
+      case "stopped": {
+        const running = this.running!;
+        this.running = undefined;
+        // Pick up final output.
+        this.poll();
+        switch (message.reason) {
+          case "default":
+            running.resolve();
+            break;
+          case "panic":
+            running.reject(new PanicError(message.code!));
+            break;
+          case "reset":
+            running.reject(new ResetError());
+            break;
+          case "error":
+            running.reject(message.error);
+            break;
+        }
+        break;
+      }
+      case "state_change": {
+        const { radio, dataLogging } = message.change;
+        if (radio) {
+          board.radio.state = radio;
+        }
+        if (dataLogging) {
+          board.dataLogging.state = dataLogging;
+        }
+        this.notifications.onStateChange(message.change);
+        break;
+      }
+      case "log_output": {
+        this.notifications.onLogOutput(message.entry);
+        break;
+      }
+      case "log_delete": {
+        this.notifications.onLogDelete();
+        break;
+      }
+      case "audio_init": {
+        board.audio[message.stream]?.init(message.sampleRate);
+        break;
+      }
+      case "audio_data": {
+        board.audio[message.stream]?.writeSamples(message.data);
+        break;
+      }
+      case "audio_volume": {
+        board.audio.setVolume(message.volume);
+        break;
+      }
+      case "audio_period": {
+        board.audio.setPeriodUs(message.periodUs);
+        break;
+      }
+      case "audio_amplitude": {
+        board.audio.setAmplitudeU10(message.amplitudeU10);
+        break;
+      }
+      case "microphone_on": {
+        board.microphone.microphoneOn();
+        break;
+      }
+      case "microphone_threshold": {
+        board.microphone.setThreshold(message.threshold, message.value);
+        break;
+      }
+      case "accelerometer_range": {
+        board.accelerometer.setRange(message.range);
+        break;
+      }
+    }
+  }
+}
@@ -0,0 +1,109 @@
+import { Firmware, LogEntry } from ".";
+import { MICROBIT_HAL_SENSOR_COUNT } from "./constants";
+import { RingBuffer } from "./ring";
+import { State } from "./state";
+import { GcStats } from "./wasm";
+
+/**
+ * Shared memory used to communicate with the worker in worker mode.
+ *
+ * High frequency traffic goes via this memory so that neither side needs to
+ * wait for the other's event loop. Everything else is a message.
+ */
+export interface SharedBuffers {
+  // Int32 sensor registers, see microbithal_js.h.
+  sensors: SharedArrayBuffer;
+  // Int32 presses for each button, added by the UI and cleared by the HAL.
+  buttonPresses: SharedArrayBuffer;
+  // Int32 frame counter followed by 25 bytes of brightness.
+  display: SharedArrayBuffer;
+  serialInput: SharedArrayBuffer;
+  serialOutput: SharedArrayBuffer;
+  radioInput: SharedArrayBuffer;
+  radioOutput: SharedArrayBuffer;
+}
+
+export class SharedState {
+  sensors: Int32Array;
+  buttonPresses: Int32Array;
+  displayCounter: Int32Array;
+  displayFrame: Uint8Array;
+  serialInput: RingBuffer;
+  serialOutput: RingBuffer;
+  radioInput: RingBuffer;
+  radioOutput: RingBuffer;
+
+  constructor(public buffers: SharedBuffers) {
+    this.sensors = new Int32Array(buffers.sensors);
+    this.buttonPresses = new Int32Array(buffers.buttonPresses);
+    this.displayCounter = new Int32Array(buffers.display, 0, 1);
+    this.displayFrame = new Uint8Array(buffers.display, 4, 25);
+    this.serialInput = new RingBuffer(buffers.serialInput);
+    this.serialOutput = new RingBuffer(buffers.serialOutput);
+    this.radioInput = new RingBuffer(buffers.radioInput);
+    this.radioOutput = new RingBuffer(buffers.radioOutput);
+  }
+
+  static create(): SharedState {
+    return new SharedState({
+      sensors: new SharedArrayBuffer(MICROBIT_HAL_SENSOR_COUNT * 4),
+      buttonPresses: new SharedArrayBuffer(2 * 4),
+      display: new SharedArrayBuffer(4 + 25),
+      serialInput: RingBuffer.create(4096).buffer,
+      serialOutput: RingBuffer.create(16384).buffer,
+      radioInput: RingBuffer.create(4096).buffer,
+      radioOutput: RingBuffer.create(4096).buffer,
+    });
+  }
+}
+
+export type AudioStream = "default" | "speech" | "soundExpression";
+
+/**
+ * Messages from the UI to the worker.
+ */
+export type ToWorkerMessage =
+  | {
+      kind: "init";
+      firmware: Firmware;
+      buffers: SharedBuffers;
+      persistentBytecodeCache: boolean;
+      wasmCacheVersion: string | undefined;
+    }
+  | { kind: "flash"; filesystem: Record<string, Uint8Array> }
+  | { kind: "start"; heapSize: number }
+  | { kind: "stop" }
+  | { kind: "gesture"; gesture: number }
+  | { kind: "level_detector"; level: number }
+  | { kind: "audio_ready"; stream: AudioStream };
+
+export type StopReason = "default" | "panic" | "reset" | "error";
+
+/**
+ * Messages from the worker to the UI.
+ *
+ * Display, serial and radio data use SharedState instead.
+ */
+export type FromWorkerMessage =
+  | { kind: "ready" }
+  | { kind: "gc_stats"; stats: GcStats }
+  | { kind: "stopped"; reason: StopReason; code?: number; error?: any }
+  /**
+   * The HAL is waiting for the UI to read serial output.
+   */
+  | { kind: "serial_output_full" }
+  | { kind: "state_change"; change: Partial<State> }
+  | { kind: "log_output"; entry: LogEntry }
+  | { kind: "log_delete" }
+  | { kind: "audio_init"; stream: AudioStream; sampleRate: number }
+  | { kind: "audio_data"; stream: AudioStream; data: Float32Array }
+  | { kind: "audio_volume"; volume: number }
+  | { kind: "audio_period"; periodUs: number }
+  | { kind: "audio_amplitude"; amplitudeU10: number }
+  | { kind: "microphone_on" }
+  | {
+      kind: "microphone_threshold";
+      threshold: "low" | "high";
+      value: number;
+    }
+  | { kind: "accelerometer_range"; range: number };
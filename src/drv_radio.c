@@ -24,6 +24,7 @@
  * THE SOFTWARE.
  */
 
+#include <string.h>
 #include "py/runtime.h"
 #include "drv_radio.h"
 #include "jshal.h"
@@ -35,17 +36,33 @@
 // 4 bytes time
 #define RADIO_PACKET_OVERHEAD (1 + 1 + 4)
 
-static uint8_t rx_buf_size = 0;
+// radio_buf holds the receive queue as a ring of fixed size packet slots,
+// written by JavaScript as packets arrive, followed by a transmit buffer.
+// The ring starts with its head slot index and packet count.
+#define RX_RING_HEAD (0)
+#define RX_RING_COUNT (1)
+#define RX_RING_SLOTS (2)
+
+static size_t radio_buf_size = 0;
+static size_t rx_slot_size = 0;
+static uint8_t rx_queue_len = 0;
+static uint8_t max_payload = 0;
 
 void microbit_radio_enable(microbit_radio_config_t *config) {
     microbit_radio_disable();
 
-    uint8_t group = config->prefix0;
-    mp_js_radio_enable(group, config->max_payload, config->queue_len);
+    max_payload = config->max_payload;
+    rx_queue_len = config->queue_len;
+    rx_slot_size = max_payload + RADIO_PACKET_OVERHEAD;
+    size_t rx_ring_size = RX_RING_SLOTS + rx_queue_len * rx_slot_size;
+    radio_buf_size = rx_ring_size + max_payload;
+    uint8_t *buf = m_new(uint8_t, radio_buf_size);
+    buf[RX_RING_HEAD] = 0;
+    buf[RX_RING_COUNT] = 0;
+    MP_STATE_PORT(radio_buf) = buf;
 
-    // We have an rx buffer of size 1, the queue itself is in the JavaScript.
-    rx_buf_size = config->max_payload + RADIO_PACKET_OVERHEAD;
-    MP_STATE_PORT(radio_buf) = m_new(uint8_t, rx_buf_size);
+    uint8_t group = config->prefix0;
+    mp_js_radio_enable(group, max_payload, rx_queue_len, buf, rx_ring_size);
 }
 
 void microbit_radio_disable(void) {
@@ -53,17 +70,12 @@ void microbit_radio_disable(void) {
 
     // free any old buffers
     if (MP_STATE_PORT(radio_buf) != NULL) {
-        m_del(uint8_t, MP_STATE_PORT(radio_buf), rx_buf_size);
+        m_del(uint8_t, MP_STATE_PORT(radio_buf), radio_buf_size);
         MP_STATE_PORT(radio_buf) = NULL;
-        rx_buf_size = 0;
+        radio_buf_size = 0;
     }
 }
 
-// Exposed so JavaScript can write directly into the max_payload sized buffer.
-uint8_t *microbit_radio_rx_buffer() {
-    return MP_STATE_PORT(radio_buf);
-}
-
 void microbit_radio_update_config(microbit_radio_config_t *config) {
     // This is not called if the max_payload or queue length change.
     // Instead we are disabled then enabled.
@@ -73,14 +85,33 @@ void microbit_radio_update_config(microbit_radio_config_t *config) {
 
 // This assumes the radio is enabled.
 void microbit_radio_send(const void *buf, size_t len, const void *buf2, size_t len2) {
-    mp_js_radio_send(buf, len, buf2, len2);
+    // Truncate at the payload size as the device does.
+    len = MIN(len, max_payload);
+    len2 = MIN(len2, max_payload - len);
+    if (len2 > 0) {
+        // Join the parts in the transmit buffer.
+        uint8_t *tx_buf = MP_STATE_PORT(radio_buf) + radio_buf_size - max_payload;
+        memcpy(tx_buf, buf, len);
+        memcpy(tx_buf + len, buf2, len2);
+        buf = tx_buf;
+        len += len2;
+    }
+    mp_js_radio_send(buf, len);
 }
 
 const uint8_t *microbit_radio_peek(void) {
-    // This call writes to the rx buffer.
-    return mp_js_radio_peek();
+    uint8_t *ring = MP_STATE_PORT(radio_buf);
+    if (ring == NULL || ring[RX_RING_COUNT] == 0) {
+        return NULL;
+    }
+    return ring + RX_RING_SLOTS + ring[RX_RING_HEAD] * rx_slot_size;
 }
 
 void microbit_radio_pop(void) {
-    mp_js_radio_pop();
+    uint8_t *ring = MP_STATE_PORT(radio_buf);
+    if (ring == NULL || ring[RX_RING_COUNT] == 0) {
+        return;
+    }
+    ring[RX_RING_HEAD] = (ring[RX_RING_HEAD] + 1) % rx_queue_len;
+    ring[RX_RING_COUNT] -= 1;
 }
@@ -1,3 +1,5 @@
 export type Stage = "local" | "REVIEW" | "STAGING" | "PRODUCTION";
 
 export const stage = (process.env.STAGE || "local") as Stage;
+
+export const version = process.env.VERSION || "local";
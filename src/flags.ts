@@ -4,19 +4,42 @@ import { Stage, stage as stageFromEnvironment } from "./environment";
  * A union of the flag names (alphabetical order).
  */
 export type Flag =
+  /**
+   * Loads the firmware built by "make jspi" instead of the Asyncify build.
+   *
+   * Needs a browser with JavaScript Promise Integration enabled.
+   */
+  | "jspi"
+  /**
+   * Persists compiled program bytecode in IndexedDB.
+   *
+   * Restarts of an unchanged program skip the compiler even across page loads.
+   */
+  | "persistentBytecodeCache"
   /**
    * Enables service worker registration.
    *
    * Registers the service worker and enables offline use.
    */
-  "sw";
+  | "sw"
+  /**
+   * Runs MicroPython in a worker so busy programs don't block the page.
+   *
+   * Needs cross-origin isolation, otherwise we run on the main thread.
+   */
+  | "worker";
 
 interface FlagMetadata {
   defaultOnStages: Stage[];
   name: Flag;
 }
 
-const allFlags: FlagMetadata[] = [{ name: "sw", defaultOnStages: [] }];
+const allFlags: FlagMetadata[] = [
+  { name: "jspi", defaultOnStages: [] },
+  { name: "persistentBytecodeCache", defaultOnStages: [] },
+  { name: "sw", defaultOnStages: [] },
+  { name: "worker", defaultOnStages: [] },
+];
 
 type Flags = Record<Flag, boolean>;
 
@@ -0,0 +1,249 @@
+import { readFileSync } from "fs";
+import * as path from "path";
+import { BytecodeCache } from "./board/bytecode-cache";
+import * as conversions from "./board/conversions";
+import { FileSystem } from "./board/fs";
+import { RealClock, VirtualClock } from "./board/clock";
+import { HeadlessBoard, HeadlessOutput } from "./board/headless-board";
+import { RadioMedium } from "./board/radio-medium";
+import { readTrace, TracePlayer } from "./board/trace";
+import {
+  defaultHeapSize,
+  EmscriptenModule,
+  GcStats,
+  ModuleWrapper,
+  PanicError,
+  ResetError,
+  validHeapSize,
+} from "./board/wasm";
+
+/**
+ * A program to run and the inputs to give it.
+ */
+export interface HeadlessScript {
+  /**
+   * File name to content, e.g. main.py.
+   */
+  files: Record<string, string>;
+  /**
+   * Stop if still running after this long. Defaults to 10 seconds.
+   */
+  timeoutMs?: number;
+  /**
+   * Stop when main.py finishes rather than running the REPL. Defaults to true.
+   */
+  stopOnFinish?: boolean;
+  /**
+   * Inputs at times relative to the program start.
+   *
+   * Sensor ids and values are as for the "set_value" message.
+   */
+  inputs?: HeadlessInput[];
+  /**
+   * Run against a virtual clock so sleeps take no real time and the result
+   * doesn't depend on the speed of the machine. Input times and the timeout
+   * are then in virtual time. Defaults to false.
+   */
+  virtualTime?: boolean;
+  /**
+   * A trace recorded by the simulator to replay. Implies virtualTime.
+   *
+   * The files should be those flashed for the recorded run.
+   */
+  replay?: Uint8Array;
+  /**
+   * The MicroPython heap size in bytes. Defaults to 64K as on a micro:bit.
+   */
+  heapSize?: number;
+}
+
+export type HeadlessInput = { timeMs: number } & (
+  | { sensor: string; value: number | string }
+  | { serial: string }
+  | { radio: number[] }
+);
+
+export type HeadlessStopReason =
+  | "finished"
+  | "timeout"
+  | "panic"
+  | "reset"
+  | "error";
+
+export interface HeadlessResult extends HeadlessOutput {
+  stopReason: HeadlessStopReason;
+  panicCode?: number;
+  error?: string;
+  durationMs: number;
+  gc?: GcStats;
+}
+
+type CreateModule = (args: object) => Promise<EmscriptenModule>;
+
+const defaultTimeoutMs = 10_000;
+
+export const compileFirmware = (firmware: string): WebAssembly.Module =>
+  new WebAssembly.Module(
+    readFileSync(path.join(__dirname, `${firmware}.wasm`))
+  );
+
+/**
+ * Runs MicroPython in Node without a DOM, e.g. to test programs in CI.
+ *
+ * Loads a firmware build from the directory containing this script. The Wasm
+ * is compiled once, or passed in already compiled, and instantiated for each
+ * run.
+ */
+export class HeadlessRunner {
+  private createModule: CreateModule;
+  private encoder = new TextEncoder();
+
+  constructor(
+    firmware: string = "firmware",
+    private compiledWasm: WebAssembly.Module = compileFirmware(firmware)
+  ) {
+    this.createModule = require(path.join(__dirname, `${firmware}.js`));
+  }
+
+  /**
+   * Create a module for the board without starting MicroPython.
+   */
+  instantiate(board: HeadlessBoard, fs: FileSystem): Promise<EmscriptenModule> {
+    return this.createModule({
+      board,
+      fs,
+      bytecodeCache: new BytecodeCache(false),
+      conversions,
+      noInitialRun: true,
+      instantiateWasm: (imports: any, successCallback: any) => {
+        WebAssembly.instantiate(this.compiledWasm, imports).then(
+          successCallback
+        );
+        // Result via callback.
+        return {};
+      },
+      // Throw ExitStatus as in the browser rather than exiting the process.
+      quit: (_status: number, toThrow: Error) => {
+        throw toThrow;
+      },
+    });
+  }
+
+  /**
+   * Run a program.
+   *
+   * @param medium A radio network to join. Runs on the same medium should run
+   * concurrently and in real time.
+   */
+  async run(
+    script: HeadlessScript,
+    medium?: RadioMedium
+  ): Promise<HeadlessResult> {
+    if (medium && (script.virtualTime || script.replay)) {
+      throw new Error("Boards on a radio network run in real time");
+    }
+    const board = new HeadlessBoard(
+      script.virtualTime || script.replay ? new VirtualClock() : new RealClock()
+    );
+    if (script.replay) {
+      board.player = new TracePlayer(readTrace(script.replay));
+    }
+    const fs = new FileSystem();
+    Object.entries(script.files).forEach(([name, content]) => {
+      fs.write(fs.create(name), this.encoder.encode(content), true);
+    });
+    const wrapped = await this.instantiate(board, fs);
+    const module = new ModuleWrapper(wrapped);
+    board.module = module;
+    board.initializeCallbacks(wrapped);
+    const detachRadio = medium?.attach(board.radio);
+
+    let stopReason: HeadlessStopReason | undefined;
+    const stop = (reason: HeadlessStopReason) => {
+      if (!stopReason) {
+        stopReason = reason;
+        board.requestStop();
+      }
+    };
+    if (script.stopOnFinish ?? true) {
+      board.onProgramFinished = () => stop("finished");
+    }
+    const { clock } = board;
+    const cancels = (script.inputs ?? []).map((input) =>
+      clock.schedule(() => {
+        if ("sensor" in input) {
+          board.setValue(input.sensor, input.value);
+        } else if ("serial" in input) {
+          board.writeSerialInput(input.serial);
+        } else if ("radio" in input) {
+          board.receiveRadio(new Uint8Array(input.radio));
+        }
+      }, input.timeMs)
+    );
+    cancels.push(
+      clock.schedule(
+        () => stop("timeout"),
+        script.timeoutMs ?? defaultTimeoutMs
+      )
+    );
+
+    const start = performance.now();
+    let panicCode: number | undefined;
+    let error: string | undefined;
+    try {
+      await module.start(validHeapSize(script.heapSize ?? defaultHeapSize));
+    } catch (e: any) {
+      if (e instanceof PanicError) {
+        stopReason ??= "panic";
+        panicCode = e.code;
+      } else if (e instanceof ResetError) {
+        stopReason ??= "reset";
+      } else {
+        stopReason ??= "error";
+        error = String(e);
+      }
+    }
+    const durationMs = performance.now() - start;
+    const gc = module.gcStats();
+    try {
+      module.forceStop();
+    } catch (e: any) {
+      if (e.name !== "ExitStatus") {
+        stopReason = "error";
+        error = String(e);
+      }
+    }
+    cancels.forEach((cancel) => cancel());
+    detachRadio?.();
+    // Called by the HAL for normal shutdown but not in error scenarios.
+    board.stopComponents();
+    board.module = undefined;
+
+    return {
+      ...board.output,
+      stopReason: stopReason ?? "finished",
+      panicCode,
+      error,
+      durationMs,
+      gc,
+    };
+  }
+
+  /**
+   * Run programs at once as boards that can hear each other's radios.
+   *
+   * @returns The results in the order of the scripts.
+   */
+  async runNetwork(
+    scripts: HeadlessScript[],
+    medium: RadioMedium = new RadioMedium()
+  ): Promise<HeadlessResult[]> {
+    try {
+      return await Promise.all(
+        scripts.map((script) => this.run(script, medium))
+      );
+    } finally {
+      medium.dispose();
+    }
+  }
+}
@@ -0,0 +1,88 @@
+import { readFileSync } from "fs";
+import { RadioMedium, RadioMediumOptions } from "./board/radio-medium";
+import { HeadlessRunner, HeadlessScript } from "./headless-runner";
+
+// Runs MicroPython in Node without a DOM, e.g. to test programs in CI.
+//
+// Usage: node build/headless.js [--firmware name] [--virtual-time]
+//          [--replay trace.bin] script.json|main.py...
+//        node build/headless.js --network [--latency ms] [--jitter ms]
+//          [--loss p] [--rssi dbm] script.json|main.py...
+//
+// Prints a HeadlessResult as JSON for each script. With --network the
+// scripts run at once as boards sharing a radio medium, and the medium's
+// packet counts go to stderr.
+
+const loadScript = (file: string): HeadlessScript => {
+  const content = readFileSync(file, { encoding: "utf-8" });
+  if (file.endsWith(".py")) {
+    return { files: { "main.py": content } };
+  }
+  return JSON.parse(content);
+};
+
+const main = async (args: string[]) => {
+  let firmware: string | undefined;
+  let virtualTime: boolean | undefined;
+  let replay: Uint8Array | undefined;
+  let network = false;
+  const networkOptions: RadioMediumOptions = {};
+  const files: string[] = [];
+  for (let i = 0; i < args.length; i++) {
+    if (args[i] === "--firmware" && i + 1 < args.length) {
+      firmware = args[++i];
+    } else if (args[i] === "--replay" && i + 1 < args.length) {
+      replay = readFileSync(args[++i]);
+    } else if (args[i] === "--virtual-time") {
+      virtualTime = true;
+    } else if (args[i] === "--network") {
+      network = true;
+    } else if (args[i] === "--latency" && i + 1 < args.length) {
+      networkOptions.latencyMs = parseFloat(args[++i]);
+    } else if (args[i] === "--jitter" && i + 1 < args.length) {
+      networkOptions.jitterMs = parseFloat(args[++i]);
+    } else if (args[i] === "--loss" && i + 1 < args.length) {
+      networkOptions.loss = parseFloat(args[++i]);
+    } else if (args[i] === "--rssi" && i + 1 < args.length) {
+      networkOptions.rssi = parseFloat(args[++i]);
+    } else {
+      files.push(args[i]);
+    }
+  }
+  if (files.length === 0) {
+    console.error(
+      "Usage: headless.js [--firmware name] [--virtual-time] [--replay trace.bin] [--network [--latency ms] [--jitter ms] [--loss p] [--rssi dbm]] script.json|main.py..."
+    );
+    process.exit(2);
+  }
+  if (!network && Object.keys(networkOptions).length > 0) {
+    console.error(
+      "--latency, --jitter, --loss and --rssi need --network to be set"
+    );
+    process.exit(2);
+  }
+  const runner = new HeadlessRunner(firmware);
+  if (network) {
+    const medium = new RadioMedium(networkOptions);
+    const results = await runner.runNetwork(files.map(loadScript), medium);
+    results.forEach((result, i) => {
+      const file = files[i];
+      process.stdout.write(JSON.stringify({ file, ...result }) + "\n");
+    });
+    console.error(JSON.stringify(medium.stats));
+    return;
+  }
+  for (const file of files) {
+    const result = await runner.run({
+      virtualTime,
+      replay,
+      ...loadScript(file),
+    });
+    process.stdout.write(JSON.stringify({ file, ...result }) + "\n");
+  }
+};
+
+main(process.argv.slice(2)).catch((e) => {
+  console.error(e);
+  process.exit(1);
+});
@@ -26,71 +26,60 @@
 
 void mp_js_hal_init(void);
 void mp_js_hal_deinit(void);
+void mp_js_hal_program_finished(void);
+void mp_js_hal_gc_collected(void);
 
 uint32_t mp_js_rng_generate_random_word();
 
 uint32_t mp_js_hal_ticks_ms(void);
-void mp_js_hal_stdout_tx_strn(const char *ptr, size_t len);
-int mp_js_hal_stdin_pop_char(void);
+uint32_t mp_js_hal_ticks_us(void);
+bool mp_js_hal_sleep(int ms);
+bool mp_js_hal_should_yield(uint32_t last_yield_ms, uint32_t interval_ms);
+bool mp_js_hal_stdout_tx_strn(const char *ptr, size_t len);
+int mp_js_hal_stdin_read(uint8_t *buf, size_t len, int interrupt_char);
 
 int mp_js_hal_filesystem_find(const char *name, size_t len);
 int mp_js_hal_filesystem_create(const char *name, size_t len);
 int mp_js_hal_filesystem_name(int idx, char *buf);
+size_t mp_js_hal_filesystem_list(char *buf, size_t len);
 int mp_js_hal_filesystem_size(int idx);
 void mp_js_hal_filesystem_remove(int idx);
-int mp_js_hal_filesystem_readbyte(int idx, size_t offset);
+int mp_js_hal_filesystem_read(int idx, size_t offset, uint8_t *buf, size_t len);
 bool mp_js_hal_filesystem_write(int idx, const char *buf, size_t len);
 
+int mp_js_hal_bytecode_cache_size(int idx);
+void mp_js_hal_bytecode_cache_read(int idx, uint8_t *buf);
+void mp_js_hal_bytecode_cache_put(int idx, const uint8_t *buf, size_t len);
+
 void mp_js_hal_panic(int code);
 void mp_js_hal_reset(void);
 
-int mp_js_hal_temperature(void);
-
 int mp_js_hal_button_get_presses(int button);
-bool mp_js_hal_button_is_pressed(int button);
 
-bool mp_js_hal_pin_is_touched(int pin);
 int mp_js_hal_pin_get_analog_period_us(int pin);
 int mp_js_hal_pin_set_analog_period_us(int pin, int period);
 
-int mp_js_hal_display_get_pixel(int x, int y);
-void mp_js_hal_display_set_pixel(int x, int y, int value);
-void mp_js_hal_display_clear(void);
-int mp_js_hal_display_read_light_level(void);
+void mp_js_hal_display_set_frame(const uint8_t *frame);
 
-int mp_js_hal_accelerometer_get_x(void);
-int mp_js_hal_accelerometer_get_y(void);
-int mp_js_hal_accelerometer_get_z(void);
-int mp_js_hal_accelerometer_get_gesture(void);
 void mp_js_hal_accelerometer_set_range(int r);
 
-int mp_js_hal_compass_get_x(void);
-int mp_js_hal_compass_get_y(void);
-int mp_js_hal_compass_get_z(void);
-int mp_js_hal_compass_get_field_strength(void);
-int mp_js_hal_compass_get_heading(void);
-
 void mp_js_hal_audio_set_volume(int value);
 void mp_js_hal_audio_init(uint32_t sample_rate);
-void mp_js_hal_audio_write_data(const uint8_t *buf, size_t num_samples);
+void mp_js_hal_audio_write_data(const float *buf, size_t num_samples);
 void mp_js_hal_audio_speech_init(uint32_t sample_rate);
-void mp_js_hal_audio_speech_write_data(const uint8_t *buf, size_t num_samples);
+void mp_js_hal_audio_speech_write_data(const float *buf, size_t num_samples);
 void mp_js_hal_audio_period_us(int period);
 void mp_js_hal_audio_amplitude_u10(int amplitude);
-void mp_js_hal_audio_play_expression(const char *name);
-void mp_js_hal_audio_stop_expression(void);
-bool mp_js_hal_audio_is_expression_active(void);
+void mp_js_hal_audio_expression_init(uint32_t sample_rate);
+void mp_js_hal_audio_expression_write_data(const float *buf, size_t num_samples);
 
 void mp_js_hal_microphone_init(void);
 void mp_js_hal_microphone_set_threshold(int kind, int value);
-int mp_js_hal_microphone_get_level(void);
 
-void mp_js_radio_enable(uint8_t group, uint8_t max_payload, uint8_t queue);
+void mp_js_radio_enable(uint8_t group, uint8_t max_payload, uint8_t queue, uint8_t *rx_ring, size_t rx_ring_size);
 void mp_js_radio_disable(void);
 void mp_js_radio_update_config(uint8_t group, uint8_t max_payload, uint8_t queue);
-void mp_js_radio_send(const void *buf, size_t len, const void *buf2, size_t len2);
-uint8_t *mp_js_radio_peek(void);
-void mp_js_radio_pop(void);
+void mp_js_radio_send(const void *buf, size_t len);
 
 void mp_js_hal_log_delete(bool full_erase);
 void mp_js_hal_log_set_mirroring(bool serial);
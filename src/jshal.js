@@ -36,23 +36,57 @@ mergeInto(LibraryManager.library, {
     Module.board.stopComponents();
   },
 
+  mp_js_hal_program_finished: function () {
+    Module.board.programFinished();
+  },
+
+  mp_js_hal_gc_collected: function () {
+    Module.board.gcCollected();
+  },
+
   mp_js_rng_generate_random_word: function () {
-    return (Math.random() * 0x100000000) >>> 0;
+    return Module.board.randomWord() >>> 0;
   },
 
   mp_js_hal_ticks_ms: function () {
     return Module.board.ticksMilliseconds();
   },
 
-  mp_js_hal_stdin_pop_char: function () {
-    return Module.board.readSerialInput();
+  mp_js_hal_ticks_us: function () {
+    // Wraps as a uint32_t like the device.
+    return Module.board.ticksMicroseconds() >>> 0;
+  },
+
+  mp_js_hal_sleep: function (/** @type {number} */ ms) {
+    return Module.board.sleep(ms);
+  },
+
+  mp_js_hal_should_yield: function (
+    /** @type {number} */ last_yield_ms,
+    /** @type {number} */ interval_ms
+  ) {
+    // Wraps as a uint32_t like the device.
+    const elapsedMs = (Module.board.ticksMilliseconds() - last_yield_ms) >>> 0;
+    return Module.board.shouldYield(elapsedMs >= interval_ms);
+  },
+
+  mp_js_hal_stdin_read: function (
+    /** @type {number} */ buf,
+    /** @type {number} */ len,
+    /** @type {number} */ interrupt_char
+  ) {
+    return Module.board.readSerialInput(
+      Module.HEAPU8.subarray(buf, buf + len),
+      interrupt_char
+    );
   },
 
   mp_js_hal_stdout_tx_strn: function (
     /** @type {number} */ ptr,
     /** @type {number} */ len
   ) {
-    Module.board.writeSerialOutput(UTF8ToString(ptr, len));
+    // True if we should back off.
+    return Module.board.writeSerialOutput(UTF8ToString(ptr, len));
   },
 
   mp_js_hal_filesystem_find: function (
@@ -83,6 +117,23 @@ mergeInto(LibraryManager.library, {
     return len;
   },
 
+  mp_js_hal_filesystem_list: function (
+    /** @type {number} */ buf,
+    /** @type {number} */ len
+  ) {
+    // Writes as many nul-terminated names as fit and returns the total size
+    // needed so the caller can retry with a larger buffer.
+    let offset = 0;
+    for (const name of Module.fs.names()) {
+      const size = lengthBytesUTF8(name) + 1;
+      if (offset + size <= len) {
+        stringToUTF8(name, buf + offset, size);
+      }
+      offset += size;
+    }
+    return offset;
+  },
+
   mp_js_hal_filesystem_size: function (/** @type {number} */ idx) {
     return Module.fs.size(idx);
   },
@@ -91,11 +142,14 @@ mergeInto(LibraryManager.library, {
     return Module.fs.remove(idx);
   },
 
-  mp_js_hal_filesystem_readbyte: function (
+  mp_js_hal_filesystem_read: function (
     /** @type {number} */ idx,
-    /** @type {number} */ offset
+    /** @type {number} */ offset,
+    /** @type {number} */ buf,
+    /** @type {number} */ len
   ) {
-    return Module.fs.readbyte(idx, offset);
+    const target = Module.HEAPU8.subarray(buf, buf + len);
+    return Module.fs.read(idx, offset, target);
   },
 
   mp_js_hal_filesystem_write: function (
@@ -107,28 +161,42 @@ mergeInto(LibraryManager.library, {
     return Module.fs.write(idx, data);
   },
 
-  mp_js_hal_reset: function () {
-    Module.board.throwReset();
+  mp_js_hal_bytecode_cache_size: function (/** @type {number} */ idx) {
+    const data = Module.bytecodeCache.get(Module.fs.contentKey(idx));
+    return data ? data.length : -1;
   },
 
-  mp_js_hal_panic: function (/** @type {number} */ code) {
-    Module.board.throwPanic(code);
+  mp_js_hal_bytecode_cache_read: function (
+    /** @type {number} */ idx,
+    /** @type {number} */ buf
+  ) {
+    const data = Module.bytecodeCache.get(Module.fs.contentKey(idx));
+    if (data) {
+      Module.HEAPU8.set(data, buf);
+    }
   },
 
-  mp_js_hal_temperature: function () {
-    return Module.board.temperature.value;
+  mp_js_hal_bytecode_cache_put: function (
+    /** @type {number} */ idx,
+    /** @type {number} */ buf,
+    /** @type {number} */ len
+  ) {
+    Module.bytecodeCache.put(
+      Module.fs.contentKey(idx),
+      Module.HEAPU8.slice(buf, buf + len)
+    );
   },
 
-  mp_js_hal_button_get_presses: function (/** @type {number} */ button) {
-    return Module.board.buttons[button].getAndClearPresses();
+  mp_js_hal_reset: function () {
+    Module.board.throwReset();
   },
 
-  mp_js_hal_button_is_pressed: function (/** @type {number} */ button) {
-    return Module.board.buttons[button].isPressed();
+  mp_js_hal_panic: function (/** @type {number} */ code) {
+    Module.board.throwPanic(code);
   },
 
-  mp_js_hal_pin_is_touched: function (/** @type {number} */ pin) {
-    return Module.board.pins[pin].isTouched();
+  mp_js_hal_button_get_presses: function (/** @type {number} */ button) {
+    return Module.board.buttons[button].getAndClearPresses();
   },
 
   mp_js_hal_pin_get_analog_period_us: function (/** @type {number} */ pin) {
@@ -142,71 +210,14 @@ mergeInto(LibraryManager.library, {
     return Module.board.pins[pin].setAnalogPeriodUs(period);
   },
 
-  mp_js_hal_display_get_pixel: function (
-    /** @type {number} */ x,
-    /** @type {number} */ y
-  ) {
-    return Module.board.display.getPixel(x, y);
-  },
-
-  mp_js_hal_display_set_pixel: function (
-    /** @type {number} */ x,
-    /** @type {number} */ y,
-    /** @type {number} */ value
-  ) {
-    Module.board.display.setPixel(x, y, value);
-  },
-
-  mp_js_hal_display_clear: function () {
-    Module.board.display.clear();
-  },
-
-  mp_js_hal_display_read_light_level: function () {
-    return Module.board.display.lightLevel.value;
-  },
-
-  mp_js_hal_accelerometer_get_x: function () {
-    return Module.board.accelerometer.state.accelerometerX.value;
-  },
-
-  mp_js_hal_accelerometer_get_y: function () {
-    return Module.board.accelerometer.state.accelerometerY.value;
-  },
-
-  mp_js_hal_accelerometer_get_z: function () {
-    return Module.board.accelerometer.state.accelerometerZ.value;
-  },
-
-  mp_js_hal_accelerometer_get_gesture: function () {
-    return Module.conversions.convertAccelerometerStringToNumber(
-      Module.board.accelerometer.state.gesture.value
-    );
+  mp_js_hal_display_set_frame: function (/** @type {number} */ frame) {
+    Module.board.display.setFrame(Module.HEAPU8.subarray(frame, frame + 25));
   },
 
   mp_js_hal_accelerometer_set_range: function (/** @type {number} */ r) {
     Module.board.accelerometer.setRange(r);
   },
 
-  mp_js_hal_compass_get_x: function () {
-    return Module.board.compass.state.compassX.value;
-  },
-
-  mp_js_hal_compass_get_y: function () {
-    return Module.board.compass.state.compassY.value;
-  },
-
-  mp_js_hal_compass_get_z: function () {
-    return Module.board.compass.state.compassZ.value;
-  },
-
-  mp_js_hal_compass_get_field_strength: function () {
-    return Module.board.compass.getFieldStrength();
-  },
-
-  mp_js_hal_compass_get_heading: function () {
-    return Module.board.compass.state.compassHeading.value;
-  },
-
   mp_js_hal_audio_set_volume: function (/** @type {number} */ value) {
     Module.board.audio.setVolume(value);
   },
@@ -221,13 +232,8 @@ mergeInto(LibraryManager.library, {
     /** @type {number} */ num_samples
   ) {
     // @ts-expect-error
-    Module.board.audio.default.writeData(
-      Module.conversions.convertAudioBuffer(
-        Module.HEAPU8,
-        buf,
-        // @ts-expect-error
-        Module.board.audio.default.createBuffer(num_samples)
-      )
+    Module.board.audio.default.writeSamples(
+      Module.HEAPF32.subarray(buf >> 2, (buf >> 2) + num_samples)
     );
   },
 
@@ -240,22 +246,9 @@ mergeInto(LibraryManager.library, {
     /** @type {number} */ buf,
     /** @type {number} */ num_samples
   ) {
-    /** @type {AudioBuffer | undefined} */ let webAudioBuffer;
-    try {
-      // @ts-expect-error
-      webAudioBuffer = Module.board.audio.speech.createBuffer(num_samples);
-    } catch (e) {
-      // Swallow error on older Safari to keep the sim in a good state.
-      // @ts-expect-error
-      if (e.name === "NotSupportedError") {
-        return;
-      } else {
-        throw e;
-      }
-    }
     // @ts-expect-error
-    Module.board.audio.speech.writeData(
-      Module.conversions.convertAudioBuffer(Module.HEAPU8, buf, webAudioBuffer)
+    Module.board.audio.speech.writeSamples(
+      Module.HEAPF32.subarray(buf >> 2, (buf >> 2) + num_samples)
     );
   },
 
@@ -283,28 +276,35 @@ mergeInto(LibraryManager.library, {
     );
   },
 
-  mp_js_hal_microphone_get_level: function () {
-    return Module.board.microphone.soundLevel.value;
-  },
-
-  mp_js_hal_audio_play_expression: function (/** @type {any} */ expr) {
-    return Module.board.audio.playSoundExpression(UTF8ToString(expr));
-  },
-
-  mp_js_hal_audio_stop_expression: function () {
-    return Module.board.audio.stopSoundExpression();
+  mp_js_hal_audio_expression_init: function (
+    /** @type {number} */ sample_rate
+  ) {
+    // @ts-expect-error
+    Module.board.audio.soundExpression.init(sample_rate);
   },
 
-  mp_js_hal_audio_is_expression_active: function () {
-    return Module.board.audio.isSoundExpressionActive();
+  mp_js_hal_audio_expression_write_data: function (
+    /** @type {number} */ buf,
+    /** @type {number} */ num_samples
+  ) {
+    // @ts-expect-error
+    Module.board.audio.soundExpression.writeSamples(
+      Module.HEAPF32.subarray(buf >> 2, (buf >> 2) + num_samples)
+    );
   },
 
   mp_js_radio_enable: function (
     /** @type {number} */ group,
     /** @type {number} */ max_payload,
-    /** @type {number} */ queue
+    /** @type {number} */ queue,
+    /** @type {number} */ rx_ring,
+    /** @type {number} */ rx_ring_size
   ) {
-    Module.board.radio.enable({ group, maxPayload: max_payload, queue });
+    // The heap doesn't grow so the view stays valid.
+    Module.board.radio.enable(
+      { group, maxPayload: max_payload, queue },
+      Module.HEAPU8.subarray(rx_ring, rx_ring + rx_ring_size)
+    );
   },
 
   mp_js_radio_disable: function () {
@@ -321,26 +321,9 @@ mergeInto(LibraryManager.library, {
 
   mp_js_radio_send: function (
     /** @type {number} */ buf,
-    /** @type {number} */ len,
-    /** @type {number} */ buf2,
-    /** @type {number} */ len2
+    /** @type {number} */ len
   ) {
-    const data = new Uint8Array(len + len2);
-    data.set(Module.HEAPU8.slice(buf, buf + len));
-    data.set(Module.HEAPU8.slice(buf2, buf2 + len2), len);
-    Module.board.radio.send(data);
-  },
-
-  mp_js_radio_peek: function () {
-    const packet = Module.board.radio.peek();
-    if (packet) {
-      return Module.board.writeRadioRxBuffer(packet);
-    }
-    return null;
-  },
-
-  mp_js_radio_pop: function () {
-    Module.board.radio.pop();
+    Module.board.radio.send(Module.HEAPU8.subarray(buf, buf + len));
   },
 
   mp_js_hal_log_delete: function (/** @type {boolean} */ full_erase) {
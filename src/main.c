@@ -40,12 +40,17 @@
 #include "drv_display.h"
 #include "modmicrobit.h"
 #include "microbithal_js.h"
+#include "jshal.h"
 
 // Set to true if a soft-timer callback can use mp_sched_exception to propagate out an exception.
 bool microbit_outer_nlr_will_handle_soft_timer_exceptions;
 
 void microbit_pyexec_file(const char *filename);
 
+// Provided by microbitfs.c.
+bool microbit_file_exists(const char *filename);
+mp_obj_t microbit_file_compile(const char *filename);
+
 bool stop_requested = 0;
 
 void mp_js_request_stop(void) {
@@ -56,18 +61,92 @@ void mp_js_force_stop(void) {
     emscripten_force_exit(0);
 }
 
+#if MICROPY_ENABLE_GC
+// Kept across calls to mp_js_main so a restart reuses it.
+static char *heap = NULL;
+static int heap_allocated_size = 0;
+#endif
+
+// The default heap size, as on a micro:bit. See defaultHeapSize in wasm.ts.
+#define MP_JS_DEFAULT_HEAP_SIZE (64 * 1024)
+
+// GC statistics for the current boot, read by JavaScript, see GcStats in wasm.ts.
+typedef struct _mp_js_gc_stats_t {
+    uint32_t heap_size;
+    uint32_t collections;
+    uint32_t collect_time_us;
+    // In bytes, as of the last collection or the end of the run. The peak is
+    // of what was left after a collection, i.e. live data.
+    uint32_t peak_used;
+    uint32_t used;
+    uint32_t free;
+    uint32_t max_free;
+} mp_js_gc_stats_t;
+
+static mp_js_gc_stats_t gc_stats;
+
+mp_js_gc_stats_t *mp_js_gc_stats(void) {
+    return &gc_stats;
+}
+
+// Walks the whole heap so take care not to do this more than needed.
+static void gc_stats_sample(void) {
+    gc_info_t info;
+    gc_info(&info);
+    gc_stats.used = info.used;
+    gc_stats.free = info.free;
+    gc_stats.max_free = info.max_free * MICROPY_BYTES_PER_GC_BLOCK;
+    if (info.used > gc_stats.peak_used) {
+        gc_stats.peak_used = info.used;
+    }
+}
+
+#if MICROPY_ENABLE_GC
+static void mp_js_alloc_heap(int heap_size) {
+    if (heap_allocated_size == heap_size) {
+        return;
+    }
+    char *new_heap = (char *)malloc(heap_size * sizeof(char));
+    if (new_heap == NULL) {
+        if (heap != NULL) {
+            // Keep the heap we have.
+            return;
+        }
+        heap_size = MP_JS_DEFAULT_HEAP_SIZE;
+        new_heap = (char *)malloc(heap_size * sizeof(char));
+        if (new_heap == NULL) {
+            // Out of memory, as MICROBIT_OOM on a device.
+            mp_js_hal_panic(20);
+        }
+    }
+    free(heap);
+    heap = new_heap;
+    heap_allocated_size = heap_size;
+}
+#endif
+
 // Main entrypoint called from JavaScript.
 // Calling mp_js_request_stop allows Ctrl-D to exit, otherwise Ctrl-D does a soft reset.
 // As we use asyncify you can await this call.
+// Once it returns it can be called again to restart without recreating the
+// module, as for a soft reset.
 void mp_js_main(int heap_size) {
+    // Start as a fresh instance would.
+    pyexec_mode_kind = PYEXEC_MODE_FRIENDLY_REPL;
+    stdin_ringbuf.iget = stdin_ringbuf.iput = 0;
+
+    #if MICROPY_ENABLE_GC
+    // Falls back to the previous or default size if there isn't the memory.
+    mp_js_alloc_heap(heap_size);
+    #endif
+
     while (!stop_requested) {
         microbit_hal_init();
         microbit_system_init();
         microbit_display_init();
 
         #if MICROPY_ENABLE_GC
-        char *heap = (char *)malloc(heap_size * sizeof(char));
-        gc_init(heap, heap + heap_size);
+        gc_init(heap, heap + heap_allocated_size);
         #endif
 
         #if MICROPY_ENABLE_PYSTACK
@@ -76,12 +155,16 @@ void mp_js_main(int heap_size) {
         #endif
 
         mp_init();
+        gc_stats = (mp_js_gc_stats_t) { .heap_size = heap_allocated_size };
 
         if (pyexec_mode_kind == PYEXEC_MODE_FRIENDLY_REPL) {
             const char *main_py = "main.py";
-            if (mp_import_stat(main_py) == MP_IMPORT_STAT_FILE) {
+            if (microbit_file_exists(main_py)) {
                 // exec("main.py")
                 microbit_pyexec_file(main_py);
+                // The REPL takes over unless the host stops us.
+                mp_hal_stdout_flush();
+                mp_js_hal_program_finished();
             } else {
                 // from microbit import *
                 mp_import_all(mp_import_name(MP_QSTR_microbit, mp_const_empty_tuple, MP_OBJ_NEW_SMALL_INT(0)));
@@ -101,12 +184,13 @@ void mp_js_main(int heap_size) {
         }
 
         mp_printf(MP_PYTHON_PRINTER, "MPY: soft reboot\n");
+        gc_stats_sample();
         //microbit_soft_timer_deinit();
         microbit_hal_deinit();
         gc_sweep_all();
         mp_deinit();
-        free(heap);
     }
+    stop_requested = 0;
 }
 
 STATIC void microbit_display_exception(mp_obj_t exc_in) {
@@ -148,11 +232,8 @@ STATIC void microbit_display_exception(mp_obj_t exc_in) {
 void microbit_pyexec_file(const char *filename) {
     nlr_buf_t nlr;
     if (nlr_push(&nlr) == 0) {
-        // Parse and comple the file.
-        mp_lexer_t *lex = mp_lexer_new_from_file(filename);
-        qstr source_name = lex->source_name;
-        mp_parse_tree_t parse_tree = mp_parse(lex, MP_PARSE_FILE_INPUT);
-        mp_obj_t module_fun = mp_compile(&parse_tree, source_name, false);
+        // Parse and compile the file, or load it from the bytecode cache.
+        mp_obj_t module_fun = microbit_file_compile(filename);
 
         // Execute the code.
         mp_hal_set_interrupt_char(CHAR_CTRL_C); // allow ctrl-C to interrupt us
@@ -188,8 +269,13 @@ STATIC void gc_scan_func(void *begin, void *end) {
 }
 
 void gc_collect(void) {
+    uint32_t start_us = mp_hal_ticks_us();
     gc_collect_start();
     emscripten_scan_stack(gc_scan_func);
     emscripten_scan_registers(gc_scan_func);
     gc_collect_end();
+    gc_stats.collect_time_us += mp_hal_ticks_us() - start_us;
+    gc_stats.collections++;
+    gc_stats_sample();
+    mp_js_hal_gc_collected();
 }
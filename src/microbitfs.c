@@ -26,6 +26,9 @@
  * THE SOFTWARE.
  */
 
+#include "py/compile.h"
+#include "py/persistentcode.h"
+#include "py/smallint.h"
 #include "py/stream.h"
 #include "py/runtime.h"
 #include "extmod/vfs.h"
@@ -39,21 +42,38 @@
 
 #define MAX_FILENAME_LENGTH (120)
 
+// Whether compiled code is cached, see mp_reader_new_file.
+#define MBFS_BYTECODE_CACHE (MICROPY_PERSISTENT_CODE_LOAD && MICROPY_PERSISTENT_CODE_SAVE)
+
+// Whether imports also use the cache, see mp_import_stat. Imports then load x.py
+// as x.mpy, which would be visible as the module's __file__.
+#define MBFS_BYTECODE_CACHE_IMPORTS (MBFS_BYTECODE_CACHE && !MICROPY_PY___FILE__)
+
 /******************************************************************************/
 // os-level functions
 
+// Fetch all filenames with a single call as a sequence of nul-terminated strings.
+STATIC char *uos_mbfs_list(size_t *len_out) {
+    size_t alloc = 256;
+    char *buf = m_new(char, alloc);
+    size_t len = mp_js_hal_filesystem_list(buf, alloc);
+    if (len > alloc) {
+        buf = m_renew(char, buf, alloc, len);
+        alloc = len;
+        len = mp_js_hal_filesystem_list(buf, alloc);
+    }
+    *len_out = len;
+    return buf;
+}
+
 STATIC mp_obj_t uos_mbfs_listdir(void) {
     mp_obj_t res = mp_obj_new_list(0, NULL);
-    char buf[MAX_FILENAME_LENGTH];
-    for (size_t i = 0;; ++i) {
-        int len = mp_js_hal_filesystem_name(i, buf);
-        if (len < 0) {
-            // End of listing.
-            break;
-        }
-        if (len > 0) {
-            mp_obj_list_append(res, mp_obj_new_str(buf, len));
-        }
+    size_t len;
+    char *buf = uos_mbfs_list(&len);
+    for (size_t pos = 0; pos < len;) {
+        size_t name_len = strlen(buf + pos);
+        mp_obj_list_append(res, mp_obj_new_str(buf + pos, name_len));
+        pos += name_len + 1;
     }
     return res;
 }
@@ -62,34 +82,33 @@ MP_DEFINE_CONST_FUN_OBJ_0(uos_mbfs_listdir_obj, uos_mbfs_listdir);
 typedef struct {
     mp_obj_base_t base;
     mp_fun_1_t iternext;
-    uint8_t idx;
+    char *names;
+    size_t len;
+    size_t pos;
 } uos_mbfs_ilistdir_it_t;
 
 STATIC mp_obj_t uos_mbfs_ilistdir_it_iternext(mp_obj_t self_in) {
     uos_mbfs_ilistdir_it_t *self = MP_OBJ_TO_PTR(self_in);
-    for (;;) {
-        char buf[MAX_FILENAME_LENGTH];
-        int len = mp_js_hal_filesystem_name(self->idx, buf);
-        if (len < 0) {
-            return MP_OBJ_STOP_ITERATION;
-        }
-        self->idx += 1;
-        if (len > 0) {
-            mp_obj_t name = mp_obj_new_str(buf, len);
-            mp_obj_tuple_t *t = MP_OBJ_TO_PTR(mp_obj_new_tuple(3, NULL));
-            t->items[0] = name;
-            t->items[1] = MP_OBJ_NEW_SMALL_INT(MP_S_IFREG); // all entries are files
-            t->items[2] = MP_OBJ_NEW_SMALL_INT(0); // no inode number
-            return MP_OBJ_FROM_PTR(t);
-        }
+    if (self->pos >= self->len) {
+        return MP_OBJ_STOP_ITERATION;
     }
+    const char *name_str = self->names + self->pos;
+    size_t name_len = strlen(name_str);
+    self->pos += name_len + 1;
+    mp_obj_t name = mp_obj_new_str(name_str, name_len);
+    mp_obj_tuple_t *t = MP_OBJ_TO_PTR(mp_obj_new_tuple(3, NULL));
+    t->items[0] = name;
+    t->items[1] = MP_OBJ_NEW_SMALL_INT(MP_S_IFREG); // all entries are files
+    t->items[2] = MP_OBJ_NEW_SMALL_INT(0); // no inode number
+    return MP_OBJ_FROM_PTR(t);
 }
 
 STATIC mp_obj_t uos_mbfs_ilistdir(void) {
     uos_mbfs_ilistdir_it_t *iter = m_new_obj(uos_mbfs_ilistdir_it_t);
     iter->base.type = &mp_type_polymorph_iter;
     iter->iternext = uos_mbfs_ilistdir_it_iternext;
-    iter->idx = 0;
+    iter->names = uos_mbfs_list(&iter->len);
+    iter->pos = 0;
     return MP_OBJ_FROM_PTR(iter);
 }
 MP_DEFINE_CONST_FUN_OBJ_0(uos_mbfs_ilistdir_obj, uos_mbfs_ilistdir);
@@ -188,17 +207,8 @@ STATIC mp_uint_t microbit_file_read(mp_obj_t self_in, void *buf_in, mp_uint_t si
         *errcode = MP_EBADF;
         return MP_STREAM_ERROR;
     }
-    uint32_t bytes_read = 0;
-    uint8_t *buf = buf_in;
-    while (size--) {
-        int chr = mp_js_hal_filesystem_readbyte(self->idx, self->offset);
-        if (chr < 0) {
-            break;
-        }
-        *buf++ = chr;
-        self->offset += 1;
-        bytes_read += 1;
-    }
+    int bytes_read = mp_js_hal_filesystem_read(self->idx, self->offset, buf_in, size);
+    self->offset += bytes_read;
     return bytes_read;
 }
 
@@ -288,8 +298,33 @@ STATIC mbfs_file_obj_t *microbit_file_open(const char *name, size_t name_len, bo
 /******************************************************************************/
 // Import and reader interface
 
+#if MBFS_BYTECODE_CACHE
+// Given the path of a .mpy file, find the index of the corresponding .py file.
+STATIC int mbfs_find_mpy_source(const char *path, size_t len, char *source) {
+    if (len < 4 || len > MICROPY_ALLOC_PATH_MAX || strcmp(path + len - 4, ".mpy") != 0) {
+        return -1;
+    }
+    memcpy(source, path, len - 3);
+    strcpy(source + len - 3, "py");
+    return mp_js_hal_filesystem_find(source, len - 1);
+}
+#endif
+
 mp_import_stat_t mp_import_stat(const char *path) {
-    int idx = mp_js_hal_filesystem_find(path, strlen(path));
+    size_t len = strlen(path);
+    #if MBFS_BYTECODE_CACHE_IMPORTS
+    // The import machinery tries x.py before x.mpy. Claim source files don't
+    // exist and report them as x.mpy instead, so that imports come through
+    // mp_reader_new_file and can use the bytecode cache.
+    if (len >= 3 && strcmp(path + len - 3, ".py") == 0) {
+        return MP_IMPORT_STAT_NO_EXIST;
+    }
+    char source[MICROPY_ALLOC_PATH_MAX];
+    if (mbfs_find_mpy_source(path, len, source) >= 0) {
+        return MP_IMPORT_STAT_FILE;
+    }
+    #endif
+    int idx = mp_js_hal_filesystem_find(path, len);
     if (idx < 0) {
         return MP_IMPORT_STAT_NO_EXIST;
     } else {
@@ -297,33 +332,159 @@ mp_import_stat_t mp_import_stat(const char *path) {
     }
 }
 
+bool microbit_file_exists(const char *filename) {
+    return mp_js_hal_filesystem_find(filename, strlen(filename)) >= 0;
+}
+
+// The lexer reads a byte at a time so buffer the file data to avoid a call
+// into JavaScript per byte.
+#define MBFS_READER_BUFFER_SIZE (256)
+
+typedef struct _mbfs_reader_t {
+    int idx;
+    size_t offset;
+    uint16_t len;
+    uint16_t pos;
+    uint8_t buf[MBFS_READER_BUFFER_SIZE];
+} mbfs_reader_t;
+
 STATIC mp_uint_t file_readbyte(void *self_in) {
-    mbfs_file_obj_t *self = self_in;
-    int chr = mp_js_hal_filesystem_readbyte(self->idx, self->offset);
-    if (chr < 0) {
-        return MP_READER_EOF;
+    mbfs_reader_t *self = self_in;
+    if (self->pos >= self->len) {
+        int len = mp_js_hal_filesystem_read(self->idx, self->offset, self->buf, MBFS_READER_BUFFER_SIZE);
+        if (len <= 0) {
+            return MP_READER_EOF;
+        }
+        self->offset += len;
+        self->len = len;
+        self->pos = 0;
     }
-    self->offset += 1;
-    return chr;
+    return self->buf[self->pos++];
 }
 
 STATIC void file_close(void *self_in) {
-    mbfs_file_obj_t *self = self_in;
-    self->open = false;
+    mbfs_reader_t *self = self_in;
+    m_del_obj(mbfs_reader_t, self);
+}
+
+STATIC void mbfs_reader_init(mp_reader_t *reader, int idx) {
+    mbfs_reader_t *data = m_new_obj(mbfs_reader_t);
+    data->idx = idx;
+    data->offset = 0;
+    data->len = 0;
+    data->pos = 0;
+    reader->data = data;
+    reader->readbyte = file_readbyte;
+    reader->close = file_close;
 }
 
 mp_lexer_t *mp_lexer_new_from_file(const char *filename) {
-    mbfs_file_obj_t *file = microbit_file_open(filename, strlen(filename), false, false);
-    if (file == NULL) {
+    int idx = mp_js_hal_filesystem_find(filename, strlen(filename));
+    if (idx < 0) {
         mp_raise_OSError(MP_ENOENT);
     }
     mp_reader_t reader;
-    reader.data = file;
-    reader.readbyte = file_readbyte;
-    reader.close = file_close;
+    mbfs_reader_init(&reader, idx);
     return mp_lexer_new(qstr_from_str(filename), reader);
 }
 
+/******************************************************************************/
+// Bytecode cache
+
+#if MBFS_BYTECODE_CACHE
+
+// Compiled code is cached in .mpy format by JavaScript, keyed on the name and
+// content of the source file, so restarting an unchanged program skips the
+// compiler. The cache may outlive the firmware so check the .mpy header as
+// mp_raw_code_load does, treating data it would reject as a miss.
+STATIC byte *mbfs_cache_get(int idx, size_t *len_out) {
+    int len = mp_js_hal_bytecode_cache_size(idx);
+    if (len < 4) {
+        return NULL;
+    }
+    byte *buf = m_new(byte, len);
+    mp_js_hal_bytecode_cache_read(idx, buf);
+    if (buf[0] != 'M'
+        || buf[1] != MPY_VERSION
+        || MPY_FEATURE_DECODE_FLAGS(buf[2]) != MPY_FEATURE_FLAGS
+        || buf[3] > MP_SMALL_INT_BITS) {
+        m_del(byte, buf, len);
+        return NULL;
+    }
+    *len_out = len;
+    return buf;
+}
+
+// Compile the file and add the result to the cache. The .mpy data is left in vstr.
+STATIC mp_raw_code_t *mbfs_compile_and_cache(const char *filename, int idx, vstr_t *vstr) {
+    mp_lexer_t *lex = mp_lexer_new_from_file(filename);
+    qstr source_name = lex->source_name;
+    mp_parse_tree_t parse_tree = mp_parse(lex, MP_PARSE_FILE_INPUT);
+    mp_raw_code_t *rc = mp_compile_to_raw_code(&parse_tree, source_name, false);
+
+    mp_print_t print;
+    vstr_init_print(vstr, 256, &print);
+    mp_raw_code_save(rc, &print);
+    mp_js_hal_bytecode_cache_put(idx, (const uint8_t *)vstr->buf, vstr->len);
+    return rc;
+}
+
+mp_obj_t microbit_file_compile(const char *filename) {
+    int idx = mp_js_hal_filesystem_find(filename, strlen(filename));
+    if (idx < 0) {
+        mp_raise_OSError(MP_ENOENT);
+    }
+    mp_raw_code_t *rc;
+    size_t len;
+    byte *buf = mbfs_cache_get(idx, &len);
+    if (buf != NULL) {
+        rc = mp_raw_code_load_mem(buf, len);
+        m_del(byte, buf, len);
+    } else {
+        vstr_t vstr;
+        rc = mbfs_compile_and_cache(filename, idx, &vstr);
+        vstr_clear(&vstr);
+    }
+    return mp_make_function_from_raw_code(rc, MP_OBJ_NULL, MP_OBJ_NULL);
+}
+
+// Used by the import machinery to load x.mpy, which we map to the cached
+// bytecode for x.py if there is such a file.
+void mp_reader_new_file(mp_reader_t *reader, const char *filename) {
+    size_t len = strlen(filename);
+    char source[MICROPY_ALLOC_PATH_MAX];
+    int idx = mbfs_find_mpy_source(filename, len, source);
+    if (idx >= 0) {
+        size_t mpy_len;
+        byte *buf = mbfs_cache_get(idx, &mpy_len);
+        if (buf != NULL) {
+            mp_reader_new_mem(reader, buf, mpy_len, mpy_len);
+        } else {
+            vstr_t vstr;
+            mbfs_compile_and_cache(source, idx, &vstr);
+            mp_reader_new_mem(reader, (const byte *)vstr.buf, vstr.len, vstr.alloc);
+        }
+        return;
+    }
+    // A .mpy file in the filesystem.
+    idx = mp_js_hal_filesystem_find(filename, len);
+    if (idx < 0) {
+        mp_raise_OSError(MP_ENOENT);
+    }
+    mbfs_reader_init(reader, idx);
+}
+
+#else
+
+mp_obj_t microbit_file_compile(const char *filename) {
+    mp_lexer_t *lex = mp_lexer_new_from_file(filename);
+    qstr source_name = lex->source_name;
+    mp_parse_tree_t parse_tree = mp_parse(lex, MP_PARSE_FILE_INPUT);
+    return mp_compile(&parse_tree, source_name, false);
+}
+
+#endif
+
 /******************************************************************************/
 // Built-in open function
 
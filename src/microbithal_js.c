@@ -1,12 +1,17 @@
 // Implementation of the microbit HAL for a JavaScript/browser environment.
 
+#include <math.h>
+#include <stdlib.h>
 #include <emscripten.h>
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
 #include "py/runtime.h"
 #include "py/mphal.h"
-#include "shared/runtime/interrupt_char.h"
 #include "microbithal.h"
 #include "microbithal_js.h"
 #include "jshal.h"
+#include "soundemoji.h"
 
 #define BITMAP_FONT_ASCII_START 32
 #define BITMAP_FONT_ASCII_END 126
@@ -19,8 +24,36 @@ const unsigned char pendolino3[475] = {
 
 static uint16_t button_state[2];
 
+static int32_t sensor_registers[MICROBIT_HAL_SENSOR_COUNT];
+
+// Exposed so JavaScript can write sensor values directly.
+int32_t *microbit_hal_sensor_registers(void) {
+    return sensor_registers;
+}
+
+// The display is buffered here and sent to JavaScript a frame at a time
+// before we yield, rather than a call per pixel. Indexed by y * 5 + x.
+static uint8_t display_frame[25];
+static bool display_dirty;
+
+static void microbit_hal_display_flush(void) {
+    if (display_dirty) {
+        display_dirty = false;
+        mp_js_hal_display_set_frame(display_frame);
+    }
+}
+
+// Yielding to the browser unwinds and rewinds the stack so we only do it once
+// this much time has passed, processing events cheaply in between.
+#define MICROBIT_HAL_YIELD_INTERVAL_MS (5)
+
+static uint32_t last_yield_ms;
+
 void microbit_hal_init(void) {
+    memset(display_frame, 0, sizeof(display_frame));
+    display_dirty = false;
     mp_js_hal_init();
+    last_yield_ms = mp_hal_ticks_ms();
 }
 
 // Sim only deinit.
@@ -30,50 +63,62 @@ void microbit_hal_deinit(void) {
     extern void microbit_radio_disable(void);
     microbit_radio_disable();
 
+    // Don't carry a sound expression over into the next run.
+    sound_emoji_stop();
+
+    mp_hal_stdout_flush();
     mp_js_hal_deinit();
 }
 
 static void microbit_hal_process_events(void) {
     // Call microbit_hal_timer_callback() every 6ms.
-    static uint32_t last_ms = 0;
-    uint32_t ms = mp_hal_ticks_ms();
-    if (ms - last_ms >= 6) {
-        last_ms = ms;
+    static uint32_t last_us = 0;
+    uint32_t us = mp_hal_ticks_us();
+    if (us - last_us >= 6000) {
+        last_us = us;
         extern void microbit_hal_timer_callback(void);
         microbit_hal_timer_callback();
     }
 
     // Process stdin.
-    int c = mp_js_hal_stdin_pop_char();
-    if (c >= 0) {
-        if (c == mp_interrupt_char) {
-            mp_sched_keyboard_interrupt();
-        } else {
-            ringbuf_put(&stdin_ringbuf, c);
-        }
+    mp_hal_stdin_fill();
+}
+
+static void microbit_hal_yield(int ms) {
+    microbit_hal_display_flush();
+    mp_hal_stdout_flush();
+    // The board may fast-forward a virtual clock instead.
+    if (mp_js_hal_sleep(ms)) {
+        emscripten_sleep(ms);
     }
+    last_yield_ms = mp_hal_ticks_ms();
 }
 
 void microbit_hal_background_processing(void) {
     microbit_hal_process_events();
-    emscripten_sleep(0);
+    // JavaScript decides so that a replayed trace yields where it was recorded.
+    if (mp_js_hal_should_yield(last_yield_ms, MICROBIT_HAL_YIELD_INTERVAL_MS)) {
+        microbit_hal_yield(0);
+    }
 }
 
 void microbit_hal_idle(void) {
     microbit_hal_process_events();
-    emscripten_sleep(5);
+    microbit_hal_yield(5);
 }
 
 void microbit_hal_reset(void) {
+    mp_hal_stdout_flush();
     mp_js_hal_reset();
 }
 
 void microbit_hal_panic(int code) {
+    mp_hal_stdout_flush();
     mp_js_hal_panic(code);
 }
 
 int microbit_hal_temperature(void) {
-    return mp_js_hal_temperature();
+    return sensor_registers[MICROBIT_HAL_SENSOR_TEMPERATURE];
 }
 
 void microbit_hal_power_clear_wake_sources(void) {
@@ -149,8 +194,10 @@ void microbit_hal_pin_write_analog_u10(int pin, int value) {
 }
 
 int microbit_hal_pin_is_touched(int pin) {
-    if (pin == MICROBIT_HAL_PIN_FACE || pin == MICROBIT_HAL_PIN_P0 || pin == MICROBIT_HAL_PIN_P1 || pin == MICROBIT_HAL_PIN_P2) {
-        return mp_js_hal_pin_is_touched(pin);
+    if (pin == MICROBIT_HAL_PIN_FACE) {
+        return sensor_registers[MICROBIT_HAL_SENSOR_PIN_LOGO];
+    } else if (pin == MICROBIT_HAL_PIN_P0 || pin == MICROBIT_HAL_PIN_P1 || pin == MICROBIT_HAL_PIN_P2) {
+        return sensor_registers[MICROBIT_HAL_SENSOR_PIN_P0 + pin - MICROBIT_HAL_PIN_P0];
     }
     /*
     if (pin == MICROBIT_HAL_PIN_FACE) {
@@ -288,7 +335,7 @@ int microbit_hal_button_state(int button, int *was_pressed, int *num_presses) {
         }
         button_state[button] = state;
     }
-    return mp_js_hal_button_is_pressed(button);
+    return sensor_registers[MICROBIT_HAL_SENSOR_BUTTON_A + button];
 }
 
 void microbit_hal_display_enable(int value) {
@@ -302,29 +349,38 @@ void microbit_hal_display_enable(int value) {
 }
 
 void microbit_hal_display_clear(void) {
-    mp_js_hal_display_clear();
+    memset(display_frame, 0, sizeof(display_frame));
+    display_dirty = true;
 }
 
 int microbit_hal_display_get_pixel(int x, int y) {
-    return mp_js_hal_display_get_pixel(x, y);
+    return display_frame[y * 5 + x];
 }
 
 void microbit_hal_display_set_pixel(int x, int y, int bright) {
-    mp_js_hal_display_set_pixel(x, y, bright);
+    if (bright < 0) {
+        bright = 0;
+    } else if (bright > 9) {
+        bright = 9;
+    }
+    if (display_frame[y * 5 + x] != bright) {
+        display_frame[y * 5 + x] = bright;
+        display_dirty = true;
+    }
 }
 
 int microbit_hal_display_read_light_level(void) {
-    return mp_js_hal_display_read_light_level();
+    return sensor_registers[MICROBIT_HAL_SENSOR_LIGHT_LEVEL];
 }
 
 void microbit_hal_accelerometer_get_sample(int axis[3]) {
-    axis[0] = mp_js_hal_accelerometer_get_x();
-    axis[1] = mp_js_hal_accelerometer_get_y();
-    axis[2] = mp_js_hal_accelerometer_get_z();
+    axis[0] = sensor_registers[MICROBIT_HAL_SENSOR_ACCELEROMETER_X];
+    axis[1] = sensor_registers[MICROBIT_HAL_SENSOR_ACCELEROMETER_Y];
+    axis[2] = sensor_registers[MICROBIT_HAL_SENSOR_ACCELEROMETER_Z];
 }
 
 int microbit_hal_accelerometer_get_gesture(void) {
-    return mp_js_hal_accelerometer_get_gesture();
+    return sensor_registers[MICROBIT_HAL_SENSOR_GESTURE];
 }
 
 void microbit_hal_accelerometer_set_range(int r) {
@@ -345,17 +401,21 @@ void microbit_hal_compass_calibrate(void) {
 }
 
 void microbit_hal_compass_get_sample(int axis[3]) {
-    axis[0] = mp_js_hal_compass_get_x();
-    axis[1] = mp_js_hal_compass_get_y();
-    axis[2] = mp_js_hal_compass_get_z();
+    axis[0] = sensor_registers[MICROBIT_HAL_SENSOR_COMPASS_X];
+    axis[1] = sensor_registers[MICROBIT_HAL_SENSOR_COMPASS_Y];
+    axis[2] = sensor_registers[MICROBIT_HAL_SENSOR_COMPASS_Z];
 }
 
 int microbit_hal_compass_get_field_strength(void) {
-    return mp_js_hal_compass_get_field_strength();
+    // Squares can exceed int32 range given nT values up to 2,000,000.
+    double x = sensor_registers[MICROBIT_HAL_SENSOR_COMPASS_X];
+    double y = sensor_registers[MICROBIT_HAL_SENSOR_COMPASS_Y];
+    double z = sensor_registers[MICROBIT_HAL_SENSOR_COMPASS_Z];
+    return sqrt(x * x + y * y + z * z);
 }
 
 int microbit_hal_compass_get_heading(void) {
-    return mp_js_hal_compass_get_heading();
+    return sensor_registers[MICROBIT_HAL_SENSOR_COMPASS_HEADING];
 }
 
 const uint8_t *microbit_hal_get_font_data(char c) {
@@ -418,19 +478,73 @@ void microbit_hal_audio_set_volume(int value) {
 
 void microbit_hal_sound_synth_callback(int event) {
     // We don't use this callback. Instead microbit_hal_audio_is_expression_active
-    // calls through to JS which has this state.
+    // asks the synthesizer, which has this state.
 }
 
 bool microbit_hal_audio_is_expression_active(void) {
-    return mp_js_hal_audio_is_expression_active();
+    return sound_emoji_is_active();
 }
 
 void microbit_hal_audio_play_expression(const char *expr) {
-    mp_js_hal_audio_play_expression(expr);
+    if (sound_emoji_play(expr)) {
+        mp_js_hal_audio_expression_init(SOUND_EMOJI_SAMPLE_RATE);
+        microbit_hal_audio_expression_ready_callback();
+    }
 }
 
 void microbit_hal_audio_stop_expression(void) {
-    mp_js_hal_audio_stop_expression();
+    sound_emoji_stop();
+}
+
+// Exported so JavaScript can ask for the next buffer of a sound expression.
+void microbit_hal_audio_expression_ready_callback(void) {
+    const float *samples = sound_emoji_pull();
+    if (samples != NULL) {
+        mp_js_hal_audio_expression_write_data(samples, SOUND_EMOJI_BUFFER_SIZE);
+    }
+}
+
+// Samples converted for Web Audio, grown to fit the largest chunk. The
+// JavaScript copies them before we're called again.
+static float *audio_samples = NULL;
+static size_t audio_samples_len = 0;
+
+// Convert unsigned 8-bit samples to floats in -1..+1.
+static const float *audio_convert_u8(const uint8_t *buf, size_t num_samples) {
+    if (num_samples > audio_samples_len) {
+        float *samples = realloc(audio_samples, num_samples * sizeof(float));
+        if (samples == NULL) {
+            return NULL;
+        }
+        audio_samples = samples;
+        audio_samples_len = num_samples;
+    }
+    float *out = audio_samples;
+    const float scale = 2.0f / 255.0f;
+    size_t i = 0;
+#ifdef __wasm_simd128__
+    const v128_t scale4 = wasm_f32x4_splat(scale);
+    const v128_t one4 = wasm_f32x4_splat(1.0f);
+    for (; i + 16 <= num_samples; i += 16) {
+        v128_t u8 = wasm_v128_load(buf + i);
+        v128_t u16[2] = {
+            wasm_u16x8_extend_low_u8x16(u8),
+            wasm_u16x8_extend_high_u8x16(u8),
+        };
+        for (int j = 0; j < 2; ++j) {
+            v128_t u32_low = wasm_u32x4_extend_low_u16x8(u16[j]);
+            v128_t u32_high = wasm_u32x4_extend_high_u16x8(u16[j]);
+            v128_t f_low = wasm_f32x4_mul(wasm_f32x4_convert_u32x4(u32_low), scale4);
+            v128_t f_high = wasm_f32x4_mul(wasm_f32x4_convert_u32x4(u32_high), scale4);
+            wasm_v128_store(out + i + j * 8, wasm_f32x4_sub(f_low, one4));
+            wasm_v128_store(out + i + j * 8 + 4, wasm_f32x4_sub(f_high, one4));
+        }
+    }
+#endif
+    for (; i < num_samples; ++i) {
+        out[i] = buf[i] * scale - 1.0f;
+    }
+    return out;
 }
 
 void microbit_hal_audio_init(uint32_t sample_rate) {
@@ -438,7 +552,10 @@ void microbit_hal_audio_init(uint32_t sample_rate) {
 }
 
 void microbit_hal_audio_write_data(const uint8_t *buf, size_t num_samples) {
-    mp_js_hal_audio_write_data(buf, num_samples);
+    const float *samples = audio_convert_u8(buf, num_samples);
+    if (samples != NULL) {
+        mp_js_hal_audio_write_data(samples, num_samples);
+    }
 }
 
 void microbit_hal_audio_speech_init(uint32_t sample_rate) {
@@ -446,7 +563,10 @@ void microbit_hal_audio_speech_init(uint32_t sample_rate) {
 }
 
 void microbit_hal_audio_speech_write_data(const uint8_t *buf, size_t num_samples) {
-    mp_js_hal_audio_speech_write_data(buf, num_samples);
+    const float *samples = audio_convert_u8(buf, num_samples);
+    if (samples != NULL) {
+        mp_js_hal_audio_speech_write_data(samples, num_samples);
+    }
 }
 
 void microbit_hal_microphone_init(void) {
@@ -480,7 +600,7 @@ void microbit_hal_microphone_set_threshold(int kind, int value) {
 }
 
 int microbit_hal_microphone_get_level(void) {
-    return mp_js_hal_microphone_get_level();
+    return sensor_registers[MICROBIT_HAL_SENSOR_SOUND_LEVEL];
     /*
     if (level == NULL) {
         return -1;
@@ -1,3 +1,31 @@
+#include <stdint.h>
+
 void microbit_hal_init(void);
 void microbit_hal_deinit(void);
 void microbit_hal_background_processing(void);
+
+// Scalar sensor values written by JavaScript when they change so reads
+// don't need to call out. Matches constants.ts.
+#define MICROBIT_HAL_SENSOR_ACCELEROMETER_X (0)
+#define MICROBIT_HAL_SENSOR_ACCELEROMETER_Y (1)
+#define MICROBIT_HAL_SENSOR_ACCELEROMETER_Z (2)
+#define MICROBIT_HAL_SENSOR_GESTURE (3)
+#define MICROBIT_HAL_SENSOR_COMPASS_X (4)
+#define MICROBIT_HAL_SENSOR_COMPASS_Y (5)
+#define MICROBIT_HAL_SENSOR_COMPASS_Z (6)
+#define MICROBIT_HAL_SENSOR_COMPASS_HEADING (7)
+#define MICROBIT_HAL_SENSOR_TEMPERATURE (8)
+#define MICROBIT_HAL_SENSOR_LIGHT_LEVEL (9)
+#define MICROBIT_HAL_SENSOR_SOUND_LEVEL (10)
+#define MICROBIT_HAL_SENSOR_BUTTON_A (11)
+#define MICROBIT_HAL_SENSOR_BUTTON_B (12)
+#define MICROBIT_HAL_SENSOR_PIN_LOGO (13)
+#define MICROBIT_HAL_SENSOR_PIN_P0 (14)
+#define MICROBIT_HAL_SENSOR_PIN_P1 (15)
+#define MICROBIT_HAL_SENSOR_PIN_P2 (16)
+#define MICROBIT_HAL_SENSOR_COUNT (17)
+
+int32_t *microbit_hal_sensor_registers(void);
+
+// Called by JavaScript when the sound expression sink wants more samples.
+void microbit_hal_audio_expression_ready_callback(void);
@@ -38,6 +38,7 @@
 #define MICROPY_EMIT_INLINE_THUMB               (1)
 
 // Python internal features
+// The HAL only yields to the browser when its time slice is used up.
 #define MICROPY_VM_HOOK_COUNT                   (256)
 #define MICROPY_VM_HOOK_INIT \
     static unsigned int vm_hook_divisor = MICROPY_VM_HOOK_COUNT;
@@ -58,6 +59,11 @@
 #define MICROPY_ENABLE_SOURCE_LINE              (1)
 #define MICROPY_FLOAT_IMPL                      (MICROPY_FLOAT_IMPL_FLOAT)
 #define MICROPY_STREAMS_NON_BLOCK               (1)
+
+// Large enough that pasting a program into the raw REPL isn't throttled.
+#ifndef MICROPY_HW_STDIN_BUFFER_LEN
+#define MICROPY_HW_STDIN_BUFFER_LEN             (4096)
+#endif
 #define MICROPY_MODULE_BUILTIN_INIT             (1)
 #define MICROPY_MODULE_WEAK_LINKS               (1)
 #define MICROPY_MODULE_FROZEN_MPY               (1)
@@ -67,6 +73,11 @@
 #define MICROPY_ENABLE_PYSTACK                  (1)
 #define MICROPY_ENABLE_SCHEDULER                (1)
 
+// Compiled code is saved to and loaded from a bytecode cache held by JavaScript.
+#define MICROPY_PERSISTENT_CODE_LOAD            (1)
+#define MICROPY_PERSISTENT_CODE_SAVE            (1)
+#define MICROPY_HAS_FILE_READER                 (1)
+
 // Fine control over Python builtins, classes, modules, etc
 #define MICROPY_PY_BUILTINS_STR_UNICODE         (1)
 #define MICROPY_PY_BUILTINS_MEMORYVIEW          (1)
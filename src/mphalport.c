@@ -1,12 +1,34 @@
+#include <string.h>
 #include <emscripten.h>
 #include "py/mphal.h"
+#include "py/runtime.h"
 #include "py/stream.h"
+#include "shared/runtime/interrupt_char.h"
 #include "microbithal_js.h"
 #include "jshal.h"
 
-static uint8_t stdin_ringbuf_array[260];
+static uint8_t stdin_ringbuf_array[MICROPY_HW_STDIN_BUFFER_LEN];
 ringbuf_t stdin_ringbuf = {stdin_ringbuf_array, sizeof(stdin_ringbuf_array), 0, 0};
 
+// Read pending input from JavaScript directly into the free space at the end
+// of the ring buffer. Returns the number of bytes read.
+int mp_hal_stdin_fill(void) {
+    ringbuf_t *r = &stdin_ringbuf;
+    // Leave a slot free so a full buffer isn't mistaken for an empty one.
+    size_t end = r->iget > r->iput ? r->iget - 1 : r->size - (r->iget == 0);
+    int len = mp_js_hal_stdin_read(r->buf + r->iput, end - r->iput, mp_interrupt_char);
+    if (len < 0) {
+        // JavaScript has read up to and consumed the interrupt character.
+        mp_sched_keyboard_interrupt();
+        return 0;
+    }
+    r->iput += len;
+    if (r->iput == r->size) {
+        r->iput = 0;
+    }
+    return len;
+}
+
 uintptr_t mp_hal_stdio_poll(uintptr_t poll_flags) {
     uintptr_t ret = 0;
     if ((poll_flags & MP_STREAM_POLL_RD) && stdin_ringbuf.iget != stdin_ringbuf.iput) {
@@ -15,8 +37,38 @@ uintptr_t mp_hal_stdio_poll(uintptr_t poll_flags) {
     return ret;
 }
 
+// Serial output is buffered and passed to JavaScript when the buffer fills or
+// we yield, rather than a call per write. Writes are never split so we don't
+// break up UTF-8 sequences.
+static char stdout_buf[1024];
+static size_t stdout_len;
+
+static void stdout_write(const char *str, size_t len) {
+    if (mp_js_hal_stdout_tx_strn(str, len)) {
+        // JavaScript has fallen behind so give it a chance to catch up.
+        microbit_hal_idle();
+    }
+}
+
+void mp_hal_stdout_flush(void) {
+    if (stdout_len > 0) {
+        // Reset first as stdout_write can yield, which flushes.
+        size_t len = stdout_len;
+        stdout_len = 0;
+        stdout_write(stdout_buf, len);
+    }
+}
+
 void mp_hal_stdout_tx_strn(const char *str, size_t len) {
-    mp_js_hal_stdout_tx_strn(str, len);
+    if (stdout_len + len > sizeof(stdout_buf)) {
+        mp_hal_stdout_flush();
+    }
+    if (len > sizeof(stdout_buf)) {
+        stdout_write(str, len);
+    } else {
+        memcpy(stdout_buf + stdout_len, str, len);
+        stdout_len += len;
+    }
 }
 
 int mp_hal_stdin_rx_chr(void) {
@@ -25,13 +77,17 @@ int mp_hal_stdin_rx_chr(void) {
         if (c != -1) {
             return c;
         }
+        if (mp_hal_stdin_fill() > 0) {
+            // More input without waiting, e.g. a paste larger than the buffer.
+            continue;
+        }
         mp_handle_pending(true);
         microbit_hal_idle();
     }
 }
 
 mp_uint_t mp_hal_ticks_us(void) {
-    return mp_js_hal_ticks_ms() * 1000;
+    return mp_js_hal_ticks_us();
 }
 
 mp_uint_t mp_hal_ticks_ms(void) {
@@ -10,6 +10,8 @@
 extern ringbuf_t stdin_ringbuf;
 
 void mp_hal_set_interrupt_char(int c);
+void mp_hal_stdout_flush(void);
+int mp_hal_stdin_fill(void);
 
 static inline uint32_t mp_hal_disable_irq(void) {
     return 0;
@@ -1,3 +1,4 @@
+import { BytecodeCache } from "./board/bytecode-cache";
 import * as conversions from "./board/conversions";
 import { FileSystem } from "./board/fs";
 import { EmscriptenModule } from "./board/wasm";
@@ -7,6 +8,7 @@ import {
   createMessageListener,
   Notifications,
 } from "./board";
+import { version } from "./environment";
 import { flags } from "./flags";
 
 declare global {
@@ -56,5 +58,11 @@ if ("serviceWorker" in navigator) {
 }
 
 const fs = new FileSystem();
-const board = createBoard(new Notifications(window.parent), fs);
+const bytecodeCache = new BytecodeCache(flags.persistentBytecodeCache);
+const board = createBoard(new Notifications(window.parent), fs, bytecodeCache, {
+  firmware: flags.jspi ? "firmware-jspi" : "firmware",
+  worker: flags.worker,
+  // Local builds don't change version.
+  wasmCacheVersion: version === "local" ? undefined : version,
+});
 window.addEventListener("message", createMessageListener(board));
@@ -0,0 +1,622 @@
+/*
+ * Adapted from Microsoft MakeCode's conversion of the CODAL synthesizer.
+ * Copyright (c) Microsoft Corporation
+ * SPDX-License-Identifier: MIT
+ *
+ * https://github.com/microsoft/pxt/blob/f2476687fe636ec7cbf47e96b22c7acec1978461/pxtsim/sound/soundEmojiSynthesizer.ts
+ * https://github.com/microsoft/pxt/blob/41530725a3d70f67ee4e501066c701e7a0c20ff6/pxtsim/sound/soundexpression.ts
+ * https://github.com/lancaster-university/codal-microbit-v2/blob/master/source/SoundExpressions.cpp
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "soundemoji.h"
+#include "jshal.h"
+
+#define TONE_WIDTH (1024)
+#define TONE_EFFECTS (3)
+#define SAMPLE_RANGE (1023)
+#define CHARS_PER_EFFECT (72)
+
+typedef struct _progression_t {
+    const double *interval;
+    int length;
+} progression_t;
+
+typedef struct _tone_effect_t tone_effect_t;
+typedef void (*tone_effect_fn_t)(const tone_effect_t *context);
+typedef double (*tone_print_fn_t)(double position);
+
+struct _tone_effect_t {
+    tone_effect_fn_t effect;
+    int step;
+    int steps;
+    double parameter;
+    const progression_t *progression;
+};
+
+typedef struct _sound_effect_t {
+    double frequency;
+    double volume;
+    int duration;
+    tone_print_fn_t tone_print;
+    tone_effect_t effects[TONE_EFFECTS];
+} sound_effect_t;
+
+static struct {
+    sound_effect_t *effects;
+    int effect_count;
+    int effect_pointer;
+    double frequency;
+    double volume;
+    double position;
+    int samples_per_step[TONE_EFFECTS];
+    int samples_to_write;
+    int samples_written;
+    bool active;
+    float buffer[SOUND_EMOJI_BUFFER_SIZE];
+} synth = { .effect_pointer = -1 };
+
+static const struct {
+    const char *name;
+    const char *expression;
+} builtin_sounds[] = {
+    { "giggle",
+      "010230988019008440044008881023001601003300240000000000000000000000000000,"
+      "110232570087411440044008880352005901003300010000000000000000010000000000,"
+      "310232729021105440288908880091006300000000240700020000000000003000000000,"
+      "310232729010205440288908880091006300000000240700020000000000003000000000,"
+      "310232729011405440288908880091006300000000240700020000000000003000000000" },
+    { "happy",
+      "010231992066911440044008880262002800001800020500000000000000010000000000,"
+      "002322129029508440240408880000000400022400110000000000000000007500000000,"
+      "000002129029509440240408880145000400022400110000000000000000007500000000" },
+    { "hello",
+      "310230673019702440118708881023012800000000240000000000000000000000000000,"
+      "300001064001602440098108880000012800000100040000000000000000000000000000,"
+      "310231064029302440098108881023012800000100040000000000000000000000000000" },
+    { "mysterious",
+      "400002390033100440240408880477000400022400110400000000000000008000000000,"
+      "405512845385000440044008880000012803010500160000000000000000085000500015" },
+    { "sad",
+      "310232226070801440162408881023012800000100240000000000000000000000000000,"
+      "310231623093602440093908880000012800000100240000000000000000000000000000" },
+    { "slide",
+      "105202325022302440240408881023012801020000110400000000000000010000000000,"
+      "010232520091002440044008881023012801022400110400000000000000010000000000" },
+    { "soaring",
+      "210234009530905440599908881023002202000400020250000000000000020000000000,"
+      "402233727273014440044008880000003101024400030000000000000000000000000000" },
+    { "spring",
+      "306590037116312440058708880807003400000000240000000000000000050000000000,"
+      "010230037116313440058708881023003100000000240000000000000000050000000000" },
+    { "twinkle",
+      "010180007672209440075608880855012800000000240000000000000000000000000000" },
+    { "yawn",
+      "200002281133202440150008881023012801024100240400030000000000010000000000,"
+      "005312520091002440044008880636012801022400110300000000000000010000000000,"
+      "008220784019008440044008880681001600005500240000000000000000005000000000,"
+      "004790784019008440044008880298001600000000240000000000000000005000000000,"
+      "003210784019008440044008880108001600003300080000000000000000005000000000" },
+};
+
+// Adapted from lancaster-university/codal-core
+// https://github.com/lancaster-university/codal-core/blob/master/source/streams/Synthesizer.cpp#L54
+static const uint16_t sine_tone[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 5, 5,
+    6, 6, 7, 7, 8, 8, 9, 9, 10, 11, 11, 12, 13, 13, 14, 15, 16, 16, 17, 18, 19,
+    20, 21, 22, 22, 23, 24, 25, 26, 27, 28, 29, 30, 32, 33, 34, 35, 36, 37, 38,
+    40, 41, 42, 43, 45, 46, 47, 49, 50, 51, 53, 54, 56, 57, 58, 60, 61, 63, 64,
+    66, 68, 69, 71, 72, 74, 76, 77, 79, 81, 82, 84, 86, 87, 89, 91, 93, 95, 96,
+    98, 100, 102, 104, 106, 108, 110, 112, 114, 116, 118, 120, 122, 124, 126,
+    128, 130, 132, 134, 136, 138, 141, 143, 145, 147, 149, 152, 154, 156, 158,
+    161, 163, 165, 167, 170, 172, 175, 177, 179, 182, 184, 187, 189, 191, 194,
+    196, 199, 201, 204, 206, 209, 211, 214, 216, 219, 222, 224, 227, 229, 232,
+    235, 237, 240, 243, 245, 248, 251, 253, 256, 259, 262, 264, 267, 270, 273,
+    275, 278, 281, 284, 287, 289, 292, 295, 298, 301, 304, 307, 309, 312, 315,
+    318, 321, 324, 327, 330, 333, 336, 339, 342, 345, 348, 351, 354, 357, 360,
+    363, 366, 369, 372, 375, 378, 381, 384, 387, 390, 393, 396, 399, 402, 405,
+    408, 411, 414, 417, 420, 424, 427, 430, 433, 436, 439, 442, 445, 448, 452,
+    455, 458, 461, 464, 467, 470, 473, 477, 480, 483, 486, 489, 492, 495, 498,
+    502, 505, 508, 511, 514, 517, 520, 524, 527, 530, 533, 536, 539, 542, 545,
+    549, 552, 555, 558, 561, 564, 567, 570, 574, 577, 580, 583, 586, 589, 592,
+    595, 598, 602, 605, 608, 611, 614, 617, 620, 623, 626, 629, 632, 635, 638,
+    641, 644, 647, 650, 653, 656, 659, 662, 665, 668, 671, 674, 677, 680, 683,
+    686, 689, 692, 695, 698, 701, 704, 707, 710, 713, 715, 718, 721, 724, 727,
+    730, 733, 735, 738, 741, 744, 747, 749, 752, 755, 758, 760, 763, 766, 769,
+    771, 774, 777, 779, 782, 785, 787, 790, 793, 795, 798, 800, 803, 806, 808,
+    811, 813, 816, 818, 821, 823, 826, 828, 831, 833, 835, 838, 840, 843, 845,
+    847, 850, 852, 855, 857, 859, 861, 864, 866, 868, 870, 873, 875, 877, 879,
+    881, 884, 886, 888, 890, 892, 894, 896, 898, 900, 902, 904, 906, 908, 910,
+    912, 914, 916, 918, 920, 922, 924, 926, 927, 929, 931, 933, 935, 936, 938,
+    940, 941, 943, 945, 946, 948, 950, 951, 953, 954, 956, 958, 959, 961, 962,
+    964, 965, 966, 968, 969, 971, 972, 973, 975, 976, 977, 979, 980, 981, 982,
+    984, 985, 986, 987, 988, 989, 990, 992, 993, 994, 995, 996, 997, 998, 999,
+    1000, 1000, 1001, 1002, 1003, 1004, 1005, 1006, 1006, 1007, 1008, 1009,
+    1009, 1010, 1011, 1011, 1012, 1013, 1013, 1014, 1014, 1015, 1015, 1016,
+    1016, 1017, 1017, 1018, 1018, 1019, 1019, 1019, 1020, 1020, 1020, 1021,
+    1021, 1021, 1021, 1022, 1022, 1022, 1022, 1022, 1022, 1022, 1022, 1022,
+    1022, 1023, 1022
+};
+
+static const double major_scale[] = {
+    1.0, 1.125, 1.25, 1.3333, 1.5, 1.6667, 1.875,
+};
+static const double minor_scale[] = {
+    1.0, 1.125, 1.2, 1.3333, 1.5, 1.6, 1.8,
+};
+static const double diminished[] = {
+    1.0, 1.2, 1.4063, 1.6667,
+};
+static const double chromatic[] = {
+    1.0, 1.0417, 1.125, 1.2, 1.25, 1.3333,
+    1.4063, 1.5, 1.6, 1.6667, 1.8, 1.875,
+};
+static const double whole_tone[] = {
+    1.0, 1.125, 1.25, 1.4063, 1.6, 1.8,
+};
+
+#define PROGRESSION(intervals) { intervals, sizeof(intervals) / sizeof(double) }
+
+static const progression_t major_scale_progression = PROGRESSION(major_scale);
+static const progression_t minor_scale_progression = PROGRESSION(minor_scale);
+static const progression_t diminished_progression = PROGRESSION(diminished);
+static const progression_t chromatic_progression = PROGRESSION(chromatic);
+static const progression_t whole_tone_progression = PROGRESSION(whole_tone);
+
+static double sine_tone_print(double position) {
+    int p = (int)position;
+    int off = TONE_WIDTH - p;
+    if (off < TONE_WIDTH / 2) {
+        p = off;
+    }
+    return sine_tone[p];
+}
+
+static double sawtooth_tone_print(double position) {
+    return position;
+}
+
+static double triangle_tone_print(double position) {
+    return position < 512 ? position * 2 : (1023 - position) * 2;
+}
+
+static double square_wave_tone_print(double position) {
+    return position < 512 ? 1023 : 0;
+}
+
+static double noise_tone_print(double position) {
+    // Deterministic, semi-random noise.
+    return (int)(position * 7919) & 1023;
+}
+
+static sound_effect_t *current_effect(void) {
+    if (synth.effect_pointer < 0 || synth.effect_pointer >= synth.effect_count) {
+        return NULL;
+    }
+    return &synth.effects[synth.effect_pointer];
+}
+
+static double frequency_from_progression(double root, const progression_t *progression,
+    int offset) {
+    int octave = offset / progression->length;
+    int index = offset % progression->length;
+    return root * pow(2, octave) * progression->interval[index];
+}
+
+// Tone effects, called at each step with the current effect's base frequency
+// and volume to work from.
+
+static void no_interpolation(const tone_effect_t *context) {
+}
+
+// parameter: end frequency
+static void linear_interpolation(const tone_effect_t *context) {
+    double base = current_effect()->frequency;
+    double interval = (context->parameter - base) / context->steps;
+    synth.frequency = base + interval * context->step;
+}
+
+// parameter: end frequency
+static void logarithmic_interpolation(const tone_effect_t *context) {
+    double base = current_effect()->frequency;
+    synth.frequency = base + (log10(fmax(context->step, 0.1)) * (context->parameter - base)) / 1.95;
+}
+
+// parameter: end frequency
+static void curve_interpolation(const tone_effect_t *context) {
+    double base = current_effect()->frequency;
+    synth.frequency = sin(context->step * 3.12159 / 180.0) * (context->parameter - base) + base;
+}
+
+// parameter: end frequency
+static void warble_interpolation(const tone_effect_t *context) {
+    double base = current_effect()->frequency;
+    synth.frequency = sin(context->step) * (context->parameter - base) + base;
+}
+
+// parameter: end frequency
+static void exponential_rising_interpolation(const tone_effect_t *context) {
+    double base = current_effect()->frequency;
+    synth.frequency = base + sin(0.01745329 * context->step) * context->parameter;
+}
+
+// parameter: end frequency
+static void exponential_falling_interpolation(const tone_effect_t *context) {
+    double base = current_effect()->frequency;
+    synth.frequency = base + cos(0.01745329 * context->step) * context->parameter;
+}
+
+static void arpeggio_ascending(const tone_effect_t *context) {
+    double base = current_effect()->frequency;
+    synth.frequency = frequency_from_progression(base, context->progression, context->step);
+}
+
+static void arpeggio_descending(const tone_effect_t *context) {
+    double base = current_effect()->frequency;
+    int offset = context->steps - context->step - 1;
+    synth.frequency = frequency_from_progression(base, context->progression, offset);
+}
+
+// parameter: vibrato frequency multiplier
+static void frequency_vibrato_effect(const tone_effect_t *context) {
+    if (context->step == 0) {
+        return;
+    }
+    if (context->step % 2 == 0) {
+        synth.frequency /= context->parameter;
+    } else {
+        synth.frequency *= context->parameter;
+    }
+}
+
+// parameter: vibrato volume multiplier
+static void volume_vibrato_effect(const tone_effect_t *context) {
+    if (context->step == 0) {
+        return;
+    }
+    if (context->step % 2 == 0) {
+        synth.volume /= context->parameter;
+    } else {
+        synth.volume *= context->parameter;
+    }
+}
+
+// parameter: end volume
+static void volume_ramp_effect(const tone_effect_t *context) {
+    double base = current_effect()->volume;
+    double delta = (context->parameter - base) / context->steps;
+    synth.volume = base + context->step * delta;
+}
+
+// Parse a zero padded decimal field, or -1 if it isn't one.
+static int parse_field(const char *chars, int start, int len) {
+    int value = 0;
+    for (int i = start; i < start + len; ++i) {
+        if (chars[i] < '0' || chars[i] > '9') {
+            return -1;
+        }
+        value = value * 10 + chars[i] - '0';
+    }
+    return value;
+}
+
+static int apply_random(int value, int rand) {
+    if (value < 0 || rand < 0) {
+        return -1;
+    }
+    if (rand == 0) {
+        // Don't use up a random word, which matters when replaying a trace.
+        return value;
+    }
+    int delta = (int)(mp_js_rng_generate_random_word() % (uint32_t)(rand * 2 + 1)) - rand;
+    return abs(value + delta);
+}
+
+static int clamp(int min, int value, int max) {
+    return value < min ? min : value > max ? max : value;
+}
+
+// See CODAL's SoundExpressions::parseSoundExpression for the format.
+static bool parse_sound_expression(const char *chars, sound_effect_t *fx) {
+    int wave = parse_field(chars, 0, 1);
+    int effect_volume = parse_field(chars, 1, 4);
+    int frequency = parse_field(chars, 5, 4);
+    int duration = parse_field(chars, 9, 4);
+    int shape = parse_field(chars, 13, 2);
+    // [15] is unused, frequency is the start frequency.
+    int end_frequency = parse_field(chars, 18, 4);
+    // [22] is unused, effect_volume is the start volume.
+    int end_volume = parse_field(chars, 26, 4);
+    int steps = parse_field(chars, 30, 4);
+    int fx_choice = parse_field(chars, 34, 2);
+    int fx_param = parse_field(chars, 36, 4);
+    int fxn_steps = parse_field(chars, 40, 4);
+
+    frequency = apply_random(frequency, parse_field(chars, 44, 4));
+    end_frequency = apply_random(end_frequency, parse_field(chars, 48, 4));
+    effect_volume = apply_random(effect_volume, parse_field(chars, 52, 4));
+    end_volume = apply_random(end_volume, parse_field(chars, 56, 4));
+    duration = apply_random(duration, parse_field(chars, 60, 4));
+    fx_param = apply_random(fx_param, parse_field(chars, 64, 4));
+    fxn_steps = apply_random(fxn_steps, parse_field(chars, 68, 4));
+
+    if (frequency == -1 || end_frequency == -1 || effect_volume == -1
+        || end_volume == -1 || duration == -1 || fx_param == -1 || fxn_steps == -1) {
+        return false;
+    }
+
+    for (int i = 0; i < TONE_EFFECTS; ++i) {
+        fx->effects[i] = (tone_effect_t){ .effect = no_interpolation };
+    }
+
+    switch (wave) {
+        case 1:
+            fx->tone_print = sawtooth_tone_print;
+            break;
+        case 2:
+            fx->tone_print = triangle_tone_print;
+            break;
+        case 3:
+            fx->tone_print = square_wave_tone_print;
+            break;
+        case 4:
+            fx->tone_print = noise_tone_print;
+            break;
+        default:
+            fx->tone_print = sine_tone_print;
+            break;
+    }
+
+    fx->frequency = frequency;
+    fx->duration = duration;
+
+    tone_effect_t *frequency_effect = &fx->effects[0];
+    frequency_effect->steps = steps;
+    frequency_effect->parameter = end_frequency;
+    switch (shape) {
+        case 1:
+            frequency_effect->effect = linear_interpolation;
+            break;
+        case 2:
+            frequency_effect->effect = curve_interpolation;
+            break;
+        case 5:
+            frequency_effect->effect = exponential_rising_interpolation;
+            break;
+        case 6:
+            frequency_effect->effect = exponential_falling_interpolation;
+            break;
+        case 8:
+        case 10:
+        case 12:
+        case 14:
+        case 16:
+            frequency_effect->effect = arpeggio_ascending;
+            break;
+        case 9:
+        case 11:
+        case 13:
+        case 15:
+        case 17:
+            frequency_effect->effect = arpeggio_descending;
+            break;
+        case 18:
+            frequency_effect->effect = logarithmic_interpolation;
+            break;
+    }
+    switch (shape) {
+        case 8:
+        case 9:
+            frequency_effect->progression = &major_scale_progression;
+            break;
+        case 10:
+        case 11:
+            frequency_effect->progression = &minor_scale_progression;
+            break;
+        case 12:
+        case 13:
+            frequency_effect->progression = &diminished_progression;
+            break;
+        case 14:
+        case 15:
+            frequency_effect->progression = &chromatic_progression;
+            break;
+        case 16:
+        case 17:
+            frequency_effect->progression = &whole_tone_progression;
+            break;
+    }
+
+    // Volume envelope.
+    fx->volume = clamp(0, effect_volume, 1023) / 1023.0;
+    fx->effects[1].effect = volume_ramp_effect;
+    fx->effects[1].steps = 36;
+    fx->effects[1].parameter = clamp(0, end_volume, 1023) / 1023.0;
+
+    // Vibrato effect, with steps spread evenly across the duration.
+    tone_effect_t *vibrato_effect = &fx->effects[2];
+    vibrato_effect->parameter = fx_param;
+    switch (fx_choice) {
+        case 1:
+            vibrato_effect->effect = frequency_vibrato_effect;
+            break;
+        case 2:
+            vibrato_effect->effect = volume_vibrato_effect;
+            break;
+        case 3:
+            vibrato_effect->effect = warble_interpolation;
+            break;
+    }
+    if (fx_choice >= 1 && fx_choice <= 3) {
+        vibrato_effect->steps = (int)floor(duration / 10000.0 * fxn_steps + 0.5);
+    }
+    return true;
+}
+
+// Parse comma separated expressions into synth.effects.
+static bool parse_sound_effects(const char *notes) {
+    int len = strlen(notes);
+    int effect_count = (len + 1) / (CHARS_PER_EFFECT + 1);
+    if (effect_count == 0 || len != effect_count * (CHARS_PER_EFFECT + 1) - 1) {
+        return false;
+    }
+    sound_effect_t *effects = malloc(effect_count * sizeof(sound_effect_t));
+    if (effects == NULL) {
+        return false;
+    }
+    for (int i = 0; i < effect_count; ++i) {
+        int start = i * (CHARS_PER_EFFECT + 1);
+        if ((start > 0 && notes[start - 1] != ',')
+            || !parse_sound_expression(notes + start, &effects[i])) {
+            free(effects);
+            return false;
+        }
+    }
+    synth.effects = effects;
+    synth.effect_count = effect_count;
+    return true;
+}
+
+static int determine_sample_count(int playout_time_ms) {
+    return (int64_t)SOUND_EMOJI_SAMPLE_RATE * abs(playout_time_ms) / 1000;
+}
+
+static void clear_effects(void) {
+    free(synth.effects);
+    synth.effects = NULL;
+    synth.effect_count = 0;
+    synth.effect_pointer = -1;
+    synth.samples_written = 0;
+    synth.samples_to_write = 0;
+    synth.position = 0;
+}
+
+// Move on to the next effect. Returns true if the last one has finished.
+static bool next_sound_effect(void) {
+    bool had_effect = current_effect() != NULL;
+    if (had_effect) {
+        synth.effect_pointer++;
+    } else {
+        synth.effect_pointer = 0;
+    }
+    if (synth.effect_pointer >= synth.effect_count) {
+        // Effects with a negative duration would repeat from the start.
+        synth.effect_pointer = 0;
+        if (synth.effect_count == 0 || synth.effects[0].duration >= 0) {
+            clear_effects();
+            return had_effect;
+        }
+    }
+
+    sound_effect_t *effect = &synth.effects[synth.effect_pointer];
+    synth.samples_to_write = determine_sample_count(effect->duration);
+    synth.frequency = effect->frequency;
+    synth.volume = effect->volume;
+    synth.samples_written = 0;
+    for (int i = 0; i < TONE_EFFECTS; ++i) {
+        tone_effect_t *tone_effect = &effect->effects[i];
+        tone_effect->step = 0;
+        if (tone_effect->steps < 1) {
+            tone_effect->steps = 1;
+        }
+        synth.samples_per_step[i] = synth.samples_to_write / tone_effect->steps;
+    }
+    return false;
+}
+
+bool sound_emoji_play(const char *expression) {
+    sound_emoji_stop();
+    for (size_t i = 0; i < sizeof(builtin_sounds) / sizeof(builtin_sounds[0]); ++i) {
+        if (strcmp(expression, builtin_sounds[i].name) == 0) {
+            expression = builtin_sounds[i].expression;
+            break;
+        }
+    }
+    if (!parse_sound_effects(expression)) {
+        return false;
+    }
+    synth.active = true;
+    next_sound_effect();
+    return true;
+}
+
+void sound_emoji_stop(void) {
+    synth.active = false;
+    clear_effects();
+}
+
+bool sound_emoji_is_active(void) {
+    return synth.active;
+}
+
+const float *sound_emoji_pull(void) {
+    if (!synth.active) {
+        return NULL;
+    }
+    float *buffer = synth.buffer;
+    int sample = 0;
+    bool done = false;
+    while (!done) {
+        if (synth.samples_written == synth.samples_to_write) {
+            bool render_complete = next_sound_effect();
+            if (synth.samples_to_write == 0) {
+                done = true;
+                if (render_complete) {
+                    synth.active = false;
+                }
+            }
+        }
+
+        while (synth.samples_written < synth.samples_to_write) {
+            sound_effect_t *effect = current_effect();
+            double skip = TONE_WIDTH * synth.frequency / SOUND_EMOJI_SAMPLE_RATE;
+            double gain = SAMPLE_RANGE * synth.volume / 1024;
+            double offset = 512 - 512 * gain;
+
+            int effect_step_end[TONE_EFFECTS];
+            int step_end_position = synth.samples_to_write;
+            for (int i = 0; i < TONE_EFFECTS; ++i) {
+                const tone_effect_t *tone_effect = &effect->effects[i];
+                effect_step_end[i] = synth.samples_per_step[i] * tone_effect->step;
+                if (tone_effect->step == tone_effect->steps - 1) {
+                    effect_step_end[i] = synth.samples_to_write;
+                }
+                if (effect_step_end[i] < step_end_position) {
+                    step_end_position = effect_step_end[i];
+                }
+            }
+
+            while (synth.samples_written < step_end_position) {
+                if (sample == SOUND_EMOJI_BUFFER_SIZE) {
+                    return buffer;
+                }
+                double s = effect->tone_print(fmax(synth.position, 0));
+                // Scale the 0..1023 tone to -1..+1.
+                buffer[sample++] = (s * gain + offset - 512) / 512;
+                synth.samples_written++;
+                synth.position += skip;
+                while (synth.position > TONE_WIDTH) {
+                    synth.position -= TONE_WIDTH;
+                }
+            }
+
+            for (int i = 0; i < TONE_EFFECTS; ++i) {
+                const tone_effect_t *tone_effect = &effect->effects[i];
+                if (synth.samples_written == effect_step_end[i]
+                    && tone_effect->step < tone_effect->steps) {
+                    tone_effect->effect(tone_effect);
+                    effect->effects[i].step++;
+                }
+            }
+        }
+    }
+
+    const float silence = (SAMPLE_RANGE * 0.5 - 512) / 512;
+    while (sample < SOUND_EMOJI_BUFFER_SIZE) {
+        buffer[sample++] = silence;
+    }
+    return buffer;
+}
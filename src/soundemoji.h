@@ -0,0 +1,17 @@
+// Sound expression synthesizer, rendering into a buffer owned by C.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SOUND_EMOJI_SAMPLE_RATE (44100)
+#define SOUND_EMOJI_BUFFER_SIZE (512)
+
+// Start playing a built-in sound name or a sound expression, stopping any
+// current one. Returns false if it can't be parsed.
+bool sound_emoji_play(const char *expression);
+void sound_emoji_stop(void);
+bool sound_emoji_is_active(void);
+
+// Render the next SOUND_EMOJI_BUFFER_SIZE samples as floats in -1..+1, or
+// NULL if nothing is playing. Padded with silence after the last effect.
+const float *sound_emoji_pull(void);
@@ -0,0 +1,197 @@
+import { existsSync } from "fs";
+import * as path from "path";
+import { beforeAll, describe, expect, it } from "vitest";
+import { VirtualClock } from "./board/clock";
+import { FileSystem } from "./board/fs";
+import { HeadlessBoard } from "./board/headless-board";
+import { EmscriptenModule } from "./board/wasm";
+import { HeadlessRunner } from "./headless-runner";
+
+// Needs the firmware, see "make".
+const firmware = "build/firmware";
+const built = existsSync(path.join(__dirname, `${firmware}.wasm`));
+
+const randomWord = 123456789;
+
+// The length, sum of absolute values and samples at spread out offsets of
+// each built-in sound as rendered by the TypeScript synthesizer that
+// soundemoji.c replaced, with the same random word throughout.
+const builtInSounds: Record<
+  string,
+  { length: number; sum: number; samples: number[] }
+> = {
+  giggle: {
+    length: 71680,
+    sum: 31396.42,
+    samples: [
+      -0.0332, 0.7343, -0.1855, 0.236, 0.0734, -0.2304, -0.6956, -0.5945,
+    ],
+  },
+  happy: {
+    length: 60928,
+    sum: 14982.4,
+    samples: [
+      -0.082, -0.4902, -0.4676, -0.2122, -0.2669, -0.1153, -0.0066, 0.0435,
+    ],
+  },
+  hello: {
+    length: 22528,
+    sum: 21566.04,
+    samples: [-0.999, -0.999, -0.999, -0.999, 0.9971, 0.9971, -0.999, 0.9971],
+  },
+  mysterious: {
+    length: 217088,
+    sum: 29690.44,
+    samples: [0, 0.4864, 0.4165, 0.3461, 0.2896, 0.2181, 0.146, 0.0733],
+  },
+  sad: {
+    length: 72704,
+    sum: 52353.84,
+    samples: [0.9971, -0.999, 0.9971, 0.9971, 0.8863, -0.666, -0.444, 0.2216],
+  },
+  slide: {
+    length: 56832,
+    sum: 32591.67,
+    samples: [-0.4075, -0.4912, 0.6868, 0.9366, 0.0956, 0.1132, 0.72, -0.0507],
+  },
+  soaring: {
+    length: 351232,
+    sum: 121868.61,
+    samples: [0.9413, 0.9023, 0.5675, -0.5981, 0.8524, 0.8424, 0.1579, -0.0158],
+  },
+  spring: {
+    length: 98816,
+    sum: 66504.08,
+    samples: [
+      0.6423, 0.6784, 0.7144, -0.752, -0.3668, 0.1502, -0.9854, -0.3259,
+    ],
+  },
+  twinkle: {
+    length: 296448,
+    sum: 172904.6,
+    samples: [
+      -0.3417, 0.9593, 0.6114, 0.8232, -0.8931, -0.219, -0.8748, -0.852,
+    ],
+  },
+  yawn: {
+    length: 130560,
+    sum: 37691.87,
+    samples: [0, 0.0322, -0.1033, 0.6026, 0.1689, -0.3427, 0.0575, -0.4481],
+  },
+};
+
+// The first effect of "hello": 197ms of square wave.
+const effect =
+  "310230673019702440118708881023012800000000240000000000000000000000000000";
+const effectSamples = Math.floor((44100 * 197) / 1000);
+const bufferSize = 512;
+
+(built ? describe : describe.skip)("sound expressions", () => {
+  let wrapped: EmscriptenModule;
+  let play: (expression: string) => void;
+  let stop: () => void;
+  let isActive: () => boolean;
+  let chunks: Float32Array[] = [];
+
+  beforeAll(async () => {
+    const board = new HeadlessBoard(new VirtualClock());
+    board.randomWord = () => randomWord;
+    board.audio.soundExpression.writeSamples = (samples: Float32Array) => {
+      chunks.push(samples.slice());
+    };
+    wrapped = await new HeadlessRunner(firmware).instantiate(
+      board,
+      new FileSystem()
+    );
+    play = wrapped.cwrap("microbit_hal_audio_play_expression", null, [
+      "string",
+    ]);
+    stop = wrapped.cwrap("microbit_hal_audio_stop_expression", null, []);
+    isActive = wrapped.cwrap(
+      "microbit_hal_audio_is_expression_active",
+      "boolean",
+      []
+    );
+  });
+
+  // As the sink would, ask for more until the expression finishes.
+  const pullAll = () => {
+    for (let i = 0; isActive(); i++) {
+      if (i > 10_000) {
+        throw new Error("Still playing");
+      }
+      wrapped._microbit_hal_audio_expression_ready_callback();
+    }
+  };
+
+  const render = (expression: string) => {
+    chunks = [];
+    play(expression);
+    pullAll();
+    const samples = new Float32Array(chunks.length * bufferSize);
+    chunks.forEach((chunk, i) => samples.set(chunk, i * bufferSize));
+    return samples;
+  };
+
+  it.each(Object.keys(builtInSounds))("renders %s as before", (name) => {
+    const { length, sum, samples } = builtInSounds[name];
+    const actual = render(name);
+    expect(actual.length).toEqual(length);
+    const actualSum = actual.reduce((acc, s) => acc + Math.abs(s), 0);
+    expect(actualSum).toBeCloseTo(sum, 1);
+    samples.forEach((sample, i) => {
+      const offset = Math.floor((length * i) / samples.length) + 123;
+      expect(actual[offset]).toBeCloseTo(sample, 3);
+    });
+  });
+
+  it("plays each effect of a sequence once", () => {
+    const samples = render([effect, effect, effect].join(","));
+    expect(samples.length).toEqual(
+      Math.ceil((effectSamples * 3) / bufferSize) * bufferSize
+    );
+    // Nothing more once finished.
+    wrapped._microbit_hal_audio_expression_ready_callback();
+    expect(chunks.length).toEqual(samples.length / bufferSize);
+  });
+
+  it("is active until the last samples are rendered", () => {
+    chunks = [];
+    play(effect);
+    expect(isActive()).toEqual(true);
+    pullAll();
+    expect(chunks.length).toEqual(Math.ceil(effectSamples / bufferSize));
+    expect(isActive()).toEqual(false);
+  });
+
+  it("stops", () => {
+    chunks = [];
+    play(effect);
+    stop();
+    expect(isActive()).toEqual(false);
+    wrapped._microbit_hal_audio_expression_ready_callback();
+    expect(chunks.length).toEqual(1);
+  });
+
+  it("restarts when played again", () => {
+    const expected = render("giggle");
+    chunks = [];
+    play("giggle");
+    wrapped._microbit_hal_audio_expression_ready_callback();
+    wrapped._microbit_hal_audio_expression_ready_callback();
+    expect(render("giggle")).toEqual(expected);
+  });
+
+  it.each([
+    "",
+    "unknown",
+    effect.slice(1),
+    effect + ",",
+    effect + effect,
+    effect + ";" + effect,
+    effect.replace("0673", "06x3"),
+  ])("ignores invalid expression %j", (expression) => {
+    expect(render(expression).length).toEqual(0);
+    expect(isActive()).toEqual(false);
+  });
+});
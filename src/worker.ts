@@ -0,0 +1,178 @@
+/// <reference lib="WebWorker" />
+import { BytecodeCache } from "./board/bytecode-cache";
+import * as conversions from "./board/conversions";
+import { FileSystem } from "./board/fs";
+import { CompiledWasm, compileWasm } from "./board/wasm-cache";
+import {
+  EmscriptenModule,
+  ModuleWrapper,
+  PanicError,
+  ResetError,
+} from "./board/wasm";
+import { WorkerBoard } from "./board/worker-board";
+import {
+  FromWorkerMessage,
+  SharedState,
+  StopReason,
+  ToWorkerMessage,
+} from "./board/worker-protocol";
+
+// Runs MicroPython off the main thread. See WorkerModule for the other side.
+
+declare const self: DedicatedWorkerGlobalScope & {
+  // Provided by the firmware script loaded on init.
+  createModule: (args: object) => Promise<EmscriptenModule>;
+};
+
+const post = (message: FromWorkerMessage, transfer: Transferable[] = []) =>
+  self.postMessage(message, transfer);
+
+let compiledWasmPromise: Promise<CompiledWasm>;
+
+const instantiateWasm = function (imports: any, successCallback: any) {
+  compiledWasmPromise
+    .then(async ({ module }) => {
+      const instance = await WebAssembly.instantiate(module, imports);
+      successCallback(instance);
+    })
+    .catch((e) => {
+      console.error("Failed to instantiate WASM");
+      console.error(e);
+    });
+  // Result via callback.
+  return {};
+};
+
+const fs = new FileSystem();
+let bytecodeCache: BytecodeCache | undefined;
+let board: WorkerBoard | undefined;
+// Defined while running for the callbacks.
+let wrapped: EmscriptenModule | undefined;
+// A stop can arrive while we're still creating the module.
+let stopRequested = false;
+// A module whose last run stopped cleanly, kept to restart in place.
+let idle: { wrapped: EmscriptenModule; module: ModuleWrapper } | undefined;
+
+const createModule = async (board: WorkerBoard) => {
+  if (idle) {
+    const result = idle;
+    idle = undefined;
+    return result;
+  }
+  await bytecodeCache!.load(async () => (await compiledWasmPromise).build);
+  const wrapped = await self.createModule({
+    board,
+    fs,
+    bytecodeCache,
+    conversions,
+    noInitialRun: true,
+    instantiateWasm,
+  });
+  return { wrapped, module: new ModuleWrapper(wrapped) };
+};
+
+const run = async (board: WorkerBoard, heapSize: number) => {
+  stopRequested = false;
+  const created = await createModule(board);
+  const { module } = created;
+  wrapped = created.wrapped;
+  board.module = module;
+  if (stopRequested) {
+    module.requestStop();
+  }
+  let reason: StopReason = "default";
+  let code: number | undefined;
+  let error: any;
+  let stoppedCleanly = false;
+  try {
+    await module.start(heapSize);
+    stoppedCleanly = true;
+  } catch (e: any) {
+    if (e instanceof PanicError) {
+      reason = "panic";
+      code = e.code;
+    } else if (e instanceof ResetError) {
+      reason = "reset";
+    } else {
+      reason = "error";
+      error = e;
+    }
+  }
+  post({ kind: "gc_stats", stats: module.gcStats() });
+  if (stoppedCleanly) {
+    // MicroPython has deinitialized so we can run it again.
+    idle = created;
+  } else {
+    // After an exception the Wasm stack and Asyncify state are unknown.
+    try {
+      module.forceStop();
+    } catch (e: any) {
+      if (e.name !== "ExitStatus") {
+        reason = "error";
+        error = e;
+      }
+    }
+  }
+  // Called by the HAL for normal shutdown but not in error scenarios.
+  board.stopComponents();
+  board.module = undefined;
+  wrapped = undefined;
+  post({ kind: "stopped", reason, code, error });
+};
+
+self.addEventListener("message", (e: MessageEvent<ToWorkerMessage>) => {
+  const { data } = e;
+  switch (data.kind) {
+    case "init": {
+      compiledWasmPromise = compileWasm(
+        `./${data.firmware}.wasm`,
+        data.wasmCacheVersion
+      );
+      importScripts(`${data.firmware}.js`);
+      bytecodeCache = new BytecodeCache(data.persistentBytecodeCache);
+      board = new WorkerBoard(new SharedState(data.buffers), post);
+      post({ kind: "ready" });
+      break;
+    }
+    case "flash": {
+      fs.clear();
+      Object.entries(data.filesystem).forEach(([name, value]) => {
+        const idx = fs.create(name);
+        fs.write(idx, value, true);
+      });
+      board!.dataLogging.delete();
+      break;
+    }
+    case "start": {
+      run(board!, data.heapSize);
+      break;
+    }
+    case "stop": {
+      stopRequested = true;
+      board!.module?.requestStop();
+      break;
+    }
+    case "gesture": {
+      wrapped?._microbit_hal_gesture_callback(data.gesture);
+      break;
+    }
+    case "level_detector": {
+      wrapped?._microbit_hal_level_detector_callback(data.level);
+      break;
+    }
+    case "audio_ready": {
+      switch (data.stream) {
+        case "default":
+          wrapped?._microbit_hal_audio_ready_callback();
+          break;
+        case "speech":
+          wrapped?._microbit_hal_audio_speech_ready_callback();
+          break;
+        case "soundExpression":
+          wrapped?._microbit_hal_audio_expression_ready_callback();
+          break;
+      }
+      break;
+    }
+  }
+});